@@ -8,6 +8,14 @@ namespace havana::tools
 		using namespace math;
 		using namespace DirectX;
 
+		// NOTE: temporary buffers of the mesh that is being processed. They're all freed at once after
+		//		 each mesh, and the memory is reused for the next one.
+		thread_local utl::linear_allocator scratch{ 1024 * 1024 };
+		template<typename T> using scratch_vector = utl::vector<T, true, utl::linear_allocator>;
+		// NOTE: the triangle corners that use a vertex. In a closed mesh, most vertices are shared by about
+		//		 six triangles, so they fit into the inline storage and only the rest takes scratch memory.
+		using corner_refs = utl::small_vector<u32, 6, true, utl::linear_allocator>;
+
 		void
 		recalculate_normals(mesh& m)
 		{
@@ -46,7 +54,7 @@ namespace havana::tools
 			assert(num_indices && num_vertices);
 
 			m.indices.resize(num_indices);
-			utl::vector<utl::vector<u32>> idx_ref(num_vertices);
+			scratch_vector<corner_refs> idx_ref(num_vertices, corner_refs{ scratch }, scratch);
 			
 			for (u32 i{ 0 }; i < num_indices; ++i)
 			{
@@ -108,7 +116,7 @@ namespace havana::tools
 
 			assert(num_vertices && num_indices);
 
-			utl::vector<utl::vector<u32>> idx_ref(num_vertices);
+			scratch_vector<corner_refs> idx_ref(num_vertices, corner_refs{ scratch }, scratch);
 
 			for (u32 i{ 0 }; i < num_indices; ++i)
 			{
@@ -191,10 +199,10 @@ namespace havana::tools
 			struct u16v2 { u16 x, y; };
 			struct u8v3 { u8 x, y, z; };
 
-			utl::vector<u8>	t_signs(num_vertices);
-			utl::vector<u16v2> normals(num_vertices);
-			utl::vector<u16v2> tangents(num_vertices);
-			utl::vector<u8v3> joint_weights(num_vertices);
+			scratch_vector<u8> t_signs(num_vertices, scratch);
+			scratch_vector<u16v2> normals(num_vertices, scratch);
+			scratch_vector<u16v2> tangents(num_vertices, scratch);
+			scratch_vector<u8v3> joint_weights(num_vertices, scratch);
 
 			if (m.elements_type & elements::elements_type::static_normal)
 			{
@@ -395,6 +403,7 @@ namespace havana::tools
 
 			determine_elements_type(m);
 			pack_vertices(m);
+			scratch.reset();
 		}
 
 		void
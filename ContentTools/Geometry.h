@@ -120,7 +120,7 @@ namespace havana::tools
 		utl::vector<math::v3>				normals;
 		utl::vector<math::v4>				tangents;
 		utl::vector<math::v3>				colors;
-		utl::vector<utl::vector<math::v2>>	uv_sets;
+		utl::small_vector<utl::vector<math::v2>, 1>	uv_sets; // usually there is only one uv set
 		utl::vector<u32>					raw_indices;
 		utl::vector<u32>					material_indices;
 		utl::vector<u32>					material_used;
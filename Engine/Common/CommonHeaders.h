@@ -12,6 +12,7 @@
 #include <memory>
 #include <unordered_map>
 #include <mutex>
+#include <atomic>
 #include <cstring>
 
 #if defined (_WIN64)
@@ -53,4 +54,5 @@
 #include "../Utilities/Math.h"
 #include "../Utilities/Utilities.h"
 #include "../Utilities/MathTypes.h"
-#include "Id.h"
\ No newline at end of file
+#include "Id.h"
+#include "../Utilities/HandlePool.h"
\ No newline at end of file
@@ -0,0 +1,420 @@
+#include <cmath>
+#include "Animation.h"
+#include "Entity.h"
+#include "Transform.h"
+#include "World.h"
+#include "Jobs/Jobs.h"
+
+namespace havana::animation
+{
+	namespace // anonymous namespace
+	{
+		struct clip_track
+		{
+			utl::vector<f32>						times;
+			utl::vector<math::v4>					values;
+		};
+
+		struct clip
+		{
+			clip_track								tracks[track_type::count];
+			f32										duration;
+			bool									loop;
+			u8										flags;	// transform::component_flags of the animated values
+		};
+
+		// NOTE: the order must match track_type.
+		constexpr u8 track_flags[]
+		{
+			(u8)transform::component_flags::position,
+			(u8)transform::component_flags::rotation,
+			(u8)transform::component_flags::scale,
+		};
+		static_assert(_countof(track_flags) == track_type::count);
+
+		constexpr u32								evaluate_batch_size{ 1024 };
+		static_assert((evaluate_batch_size & 3) == 0, "Batch size must be a multiple of 4.");
+
+		// NOTE: clips are assets, which are shared by all worlds. The mutex keeps create_clip(), remove_clip()
+		//		 and play() of different threads apart. update() reads the clips without it.
+		utl::handle_pool<clip>						clips;
+		std::mutex									clips_mutex;
+	} // anonymous namespace
+
+	namespace detail
+	{
+		struct world_data
+		{
+			// Entities that play a clip, one per instance. Instances are swap-removed, so they stay dense.
+			utl::vector<transform::transform_id>	ids;
+			utl::vector<clip_id>					clip_ids;
+			utl::vector<f32>						times;
+			utl::vector<f32>						speeds;
+			utl::vector<u8>							flags;
+			utl::vector<u8>							finished;
+			// NOTE: the key each track used in the last update. Time moves forward by less than
+			//		 a key most of the time, so finding the next key is usually a single compare.
+			utl::vector<u32>						keys[track_type::count];
+
+			// Index of the instance of each entity, indexed by entity index (u32_invalid_id if there's none).
+			utl::vector<u32>						instance_indices;
+		};
+	} // detail namespace
+
+	namespace // anonymous namespace
+	{
+		using detail::world_data;
+
+		// NOTE: null until the thread first uses the animation system or makes a world current.
+		thread_local world_data*					current_world{ nullptr };
+
+		world_data&
+		current()
+		{
+			if (!current_world) world::set_current(world::default_world());
+			return *current_world;
+		}
+
+		u32
+		get_instance(const world_data& state, game_entity::entity_id id)
+		{
+			const u32 index{ id::index(id) };
+			return index < state.instance_indices.size() ? state.instance_indices[index] : u32_invalid_id;
+		}
+
+		void
+		remove_instance(world_data& state, u32 instance)
+		{
+			const u32 last{ (u32)state.ids.size() - 1 };
+			assert(instance <= last);
+			state.instance_indices[id::index(state.ids[instance])] = u32_invalid_id;
+
+			if (instance != last)
+			{
+				state.ids[instance] = state.ids[last];
+				state.clip_ids[instance] = state.clip_ids[last];
+				state.times[instance] = state.times[last];
+				state.speeds[instance] = state.speeds[last];
+				state.flags[instance] = state.flags[last];
+				state.finished[instance] = state.finished[last];
+				for (u32 i{ 0 }; i < track_type::count; ++i) state.keys[i][instance] = state.keys[i][last];
+				state.instance_indices[id::index(state.ids[instance])] = instance;
+			}
+
+			state.ids.resize(last);
+			state.clip_ids.resize(last);
+			state.times.resize(last);
+			state.speeds.resize(last);
+			state.flags.resize(last);
+			state.finished.resize(last);
+			for (u32 i{ 0 }; i < track_type::count; ++i) state.keys[i].resize(last);
+		}
+
+		// Moves the time of an instance forward and finds the keys to interpolate for each track.
+		// 'a' and 'b' are the indices of the two keys and 'w' is the weight of 'b'.
+		void
+		advance(world_data& state, u32 instance, f32 dt, u32 (&a)[track_type::count], u32 (&b)[track_type::count], f32 (&w)[track_type::count])
+		{
+			const clip& c{ clips[state.clip_ids[instance]] };
+			f32 time{ state.times[instance] + dt * state.speeds[instance] };
+			if (c.loop)
+			{
+				if (time >= c.duration || time < 0.f)
+				{
+					time = std::fmod(time, c.duration);
+					if (time < 0.f) time += c.duration;
+				}
+			}
+			else if (time >= c.duration || time < 0.f)
+			{
+				time = time < 0.f ? 0.f : c.duration;
+				state.finished[instance] = 1;
+			}
+			state.times[instance] = time;
+
+			for (u32 i{ 0 }; i < track_type::count; ++i)
+			{
+				const utl::vector<f32>& times{ c.tracks[i].times };
+				const u32 count{ (u32)times.size() };
+				if (!count) continue;
+
+				u32 key{ state.keys[i][instance] };
+				// NOTE: the clip started over or plays backwards.
+				if (key >= count || time < times[key]) key = 0;
+				while (key + 1 < count && times[key + 1] <= time) ++key;
+				state.keys[i][instance] = key;
+
+				a[i] = key;
+				b[i] = key + 1 < count ? key + 1 : key;
+				const f32 span{ times[b[i]] - times[key] };
+				w[i] = span > 0.f && time > times[key] ? (time - times[key]) / span : 0.f;
+			}
+		}
+
+		// Evaluates up to four instances at once. The keys of the instances are transposed so that each SIMD
+		// lane holds one instance, like in the matrix calculations of the transform system.
+		void
+		evaluate_x4(world_data& state, const transform::mutable_view& view, u32 first, u32 count, f32 dt)
+		{
+			using namespace DirectX;
+			assert(count && count <= 4);
+			u32 a[4][track_type::count]{};
+			u32 b[4][track_type::count]{};
+			f32 w[4][track_type::count]{};
+			const clip* lane_clips[4]{};
+			for (u32 lane{ 0 }; lane < count; ++lane)
+			{
+				advance(state, first + lane, dt, a[lane], b[lane], w[lane]);
+				lane_clips[lane] = &clips[state.clip_ids[first + lane]];
+			}
+
+			for (u32 track{ 0 }; track < track_type::count; ++track)
+			{
+				XMVECTOR from[4];
+				XMVECTOR to[4];
+				f32 weights[4]{};
+				bool has_track{ false };
+				for (u32 lane{ 0 }; lane < 4; ++lane)
+				{
+					// NOTE: unused lanes repeat the first lane and aren't stored.
+					const u32 l{ lane < count ? lane : 0 };
+					const clip_track& t{ lane_clips[l]->tracks[track] };
+					if (t.values.empty())
+					{
+						from[lane] = to[lane] = XMQuaternionIdentity();
+						continue;
+					}
+
+					has_track = true;
+					from[lane] = XMLoadFloat4(&t.values[a[l][track]]);
+					to[lane] = XMLoadFloat4(&t.values[b[l][track]]);
+					weights[lane] = w[l][track];
+				}
+				if (!has_track) continue;
+
+				const XMMATRIX p{ XMMatrixTranspose(XMMATRIX{ from[0], from[1], from[2], from[3] }) };
+				const XMMATRIX q{ XMMatrixTranspose(XMMATRIX{ to[0], to[1], to[2], to[3] }) };
+				const XMVECTOR weight{ XMLoadFloat4((const XMFLOAT4*)&weights[0]) };
+				XMMATRIX r{
+					XMVectorMultiplyAdd(XMVectorSubtract(q.r[0], p.r[0]), weight, p.r[0]),
+					XMVectorMultiplyAdd(XMVectorSubtract(q.r[1], p.r[1]), weight, p.r[1]),
+					XMVectorMultiplyAdd(XMVectorSubtract(q.r[2], p.r[2]), weight, p.r[2]),
+					XMVectorMultiplyAdd(XMVectorSubtract(q.r[3], p.r[3]), weight, p.r[3]) };
+
+				if (track == track_type::rotation)
+				{
+					XMVECTOR length_sq{ XMVectorMultiply(r.r[0], r.r[0]) };
+					length_sq = XMVectorMultiplyAdd(r.r[1], r.r[1], length_sq);
+					length_sq = XMVectorMultiplyAdd(r.r[2], r.r[2], length_sq);
+					length_sq = XMVectorMultiplyAdd(r.r[3], r.r[3], length_sq);
+					const XMVECTOR inv_length{ XMVectorReciprocalSqrt(length_sq) };
+					for (u32 i{ 0 }; i < 4; ++i) r.r[i] = XMVectorMultiply(r.r[i], inv_length);
+				}
+
+				r = XMMatrixTranspose(r);
+				for (u32 lane{ 0 }; lane < count; ++lane)
+				{
+					if (lane_clips[lane]->tracks[track].values.empty()) continue;
+					const u32 index{ (u32)id::index(state.ids[first + lane]) };
+					if (track == track_type::rotation) XMStoreFloat4(&view.rotations[index], r.r[lane]);
+					else XMStoreFloat3(track == track_type::position ? &view.positions[index] : &view.scales[index], r.r[lane]);
+				}
+			}
+		}
+	} // anonymous namespace
+
+	namespace detail
+	{
+		world_data*
+		create_world()
+		{
+			return new world_data{};
+		}
+
+		void
+		remove_world(world_data* const data)
+		{
+			assert(data);
+			delete data;
+		}
+
+		void
+		set_current_world(world_data* const data)
+		{
+			current_world = data;
+		}
+
+		u64
+		snapshot_size(const world_data* const data)
+		{
+			assert(data);
+			using writer = utl::blob_stream_writer;
+			u64 size{ writer::items_size(data->ids) + writer::items_size(data->clip_ids) };
+			size += writer::items_size(data->times) + writer::items_size(data->speeds);
+			size += writer::items_size(data->flags) + writer::items_size(data->finished);
+			for (u32 i{ 0 }; i < track_type::count; ++i) size += writer::items_size(data->keys[i]);
+			size += writer::items_size(data->instance_indices);
+			return size;
+		}
+
+		void
+		save_world(const world_data* const data, utl::blob_stream_writer& writer)
+		{
+			assert(data);
+			writer.write_items(data->ids);
+			writer.write_items(data->clip_ids);
+			writer.write_items(data->times);
+			writer.write_items(data->speeds);
+			writer.write_items(data->flags);
+			writer.write_items(data->finished);
+			for (u32 i{ 0 }; i < track_type::count; ++i) writer.write_items(data->keys[i]);
+			writer.write_items(data->instance_indices);
+		}
+
+		void
+		restore_world(world_data* const data, utl::blob_stream_reader& reader)
+		{
+			assert(data);
+			reader.read_items(data->ids);
+			reader.read_items(data->clip_ids);
+			reader.read_items(data->times);
+			reader.read_items(data->speeds);
+			reader.read_items(data->flags);
+			reader.read_items(data->finished);
+			for (u32 i{ 0 }; i < track_type::count; ++i) reader.read_items(data->keys[i]);
+			reader.read_items(data->instance_indices);
+		}
+	} // detail namespace
+
+	clip_id
+	create_clip(const clip_info& info)
+	{
+		assert(info.duration > 0.f);
+		clip c{};
+		c.duration = info.duration;
+		c.loop = info.loop;
+
+		for (u32 i{ 0 }; i < track_type::count; ++i)
+		{
+			const track& t{ info.tracks[i] };
+			if (!t.count) continue;
+			assert(t.times && t.values);
+
+			clip_track& ct{ c.tracks[i] };
+			ct.times.resize(t.count);
+			ct.values.resize(t.count);
+			memcpy(ct.times.data(), t.times, t.count * sizeof(f32));
+			memcpy(ct.values.data(), t.values, t.count * sizeof(math::v4));
+			c.flags |= track_flags[i];
+
+			for (u32 k{ 1 }; k < t.count; ++k)
+			{
+				assert(ct.times[k - 1] <= ct.times[k]);
+				if (i != track_type::rotation) continue;
+
+				// q and -q are the same rotation. Interpolating between keys in opposite
+				// hemispheres would take the long way around, so we flip them.
+				using namespace DirectX;
+				const XMVECTOR previous{ XMLoadFloat4(&ct.values[k - 1]) };
+				const XMVECTOR key{ XMLoadFloat4(&ct.values[k]) };
+				if (XMVectorGetX(XMQuaternionDot(previous, key)) < 0.f) XMStoreFloat4(&ct.values[k], XMVectorNegate(key));
+			}
+		}
+
+		std::lock_guard lock{ clips_mutex };
+		return clip_id{ clips.add(std::move(c)) };
+	}
+
+	void
+	remove_clip(clip_id id)
+	{
+#ifdef _DEBUG
+		// NOTE: only the current world can be checked here.
+		for (const clip_id playing : current().clip_ids) assert(playing != id);
+#endif
+		std::lock_guard lock{ clips_mutex };
+		assert(id::is_valid(id) && clips.is_alive(id));
+		clips.remove(id);
+	}
+
+	void
+	play(game_entity::entity_id id, const play_info& info)
+	{
+		assert(game_entity::is_alive(id));
+		world_data& state{ current() };
+		u8 clip_flags{ 0 };
+		{
+			std::lock_guard lock{ clips_mutex };
+			assert(id::is_valid(info.clip) && clips.is_alive(info.clip));
+			clip_flags = clips[info.clip].flags;
+		}
+
+		u32 instance{ get_instance(state, id) };
+		if (instance == u32_invalid_id)
+		{
+			const u32 index{ id::index(id) };
+			if (index >= state.instance_indices.size()) state.instance_indices.resize(index + 1, u32_invalid_id);
+
+			instance = (u32)state.ids.size();
+			state.instance_indices[index] = instance;
+			state.ids.emplace_back(transform::transform_id{ id });
+			state.clip_ids.emplace_back();
+			state.times.emplace_back();
+			state.speeds.emplace_back();
+			state.flags.emplace_back();
+			state.finished.emplace_back();
+			for (u32 i{ 0 }; i < track_type::count; ++i) state.keys[i].emplace_back();
+		}
+
+		state.clip_ids[instance] = info.clip;
+		state.times[instance] = info.start_time;
+		state.speeds[instance] = info.speed;
+		state.flags[instance] = clip_flags;
+		state.finished[instance] = 0;
+		for (u32 i{ 0 }; i < track_type::count; ++i) state.keys[i][instance] = 0;
+	}
+
+	void
+	stop(game_entity::entity_id id)
+	{
+		world_data& state{ current() };
+		const u32 instance{ get_instance(state, id) };
+		if (instance != u32_invalid_id && state.ids[instance] == transform::transform_id{ id })
+		{
+			remove_instance(state, instance);
+		}
+	}
+
+	bool
+	is_playing(game_entity::entity_id id)
+	{
+		world_data& state{ current() };
+		const u32 instance{ get_instance(state, id) };
+		return instance != u32_invalid_id && state.ids[instance] == transform::transform_id{ id };
+	}
+
+	void
+	update(f32 dt)
+	{
+		world_data& state{ current() };
+		const u32 count{ (u32)state.ids.size() };
+		if (!count) return;
+
+		const transform::mutable_view view{ transform::get_mutable_view() };
+		jobs::parallel_for(count, evaluate_batch_size, [&state, &view, dt](u32 begin, u32 end)
+			{
+				for (u32 i{ begin }; i < end; i += 4)
+				{
+					evaluate_x4(state, view, i, std::min(end - i, 4u), dt);
+				}
+			});
+
+		transform::set_changed(state.ids.data(), state.flags.data(), count);
+
+		// Clips that don't loop stop playing once they reach their end.
+		for (u32 i{ count }; i > 0; --i)
+		{
+			if (state.finished[i - 1]) remove_instance(state, i - 1);
+		}
+	}
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include "ComponentsCommon.h"
+
+namespace havana::animation
+{
+	// Animates transforms with keyframe tracks instead of per-entity scripts. A clip has up to one track
+	// for each of position, rotation and scale, and any number of entities can play the same clip.
+	// All animated entities of a world are evaluated in one pass per frame, four at a time, and the
+	// results are written straight into the transform arrays.
+
+	DEFINE_TYPED_ID(clip_id);
+
+	struct track_type
+	{
+		enum type : u32
+		{
+			position,
+			rotation,
+			scale,
+
+			count
+		};
+	};
+
+	// Keys are sorted by time. Values are (x, y, z) for positions and scales and quaternions for rotations.
+	// NOTE: rotations are interpolated linearly and normalized, which is only close to a constant angular
+	//		 speed for small angles. Keep consecutive rotation keys less than about 45 degrees apart.
+	struct track
+	{
+		const f32*			times{ nullptr };
+		const math::v4*		values{ nullptr };
+		u32					count{ 0 };		// 0 if the clip doesn't animate this value
+	};
+
+	struct clip_info
+	{
+		track				tracks[track_type::count]{};
+		// Looping clips start over after 'duration' seconds. Other clips stop playing at the end
+		// and leave the transform at the values of their last keys.
+		f32					duration{ 0.f };
+		bool				loop{ true };
+	};
+
+	struct play_info
+	{
+		clip_id				clip{ id::invalid_id };
+		f32					speed{ 1.f };	// negative speeds play the clip backwards
+		f32					start_time{ 0.f };
+	};
+
+	// Clips are shared by all worlds. Don't create or remove clips while a world is being updated.
+	clip_id create_clip(const clip_info& info);
+	// The clip must not be playing on any entity in any world.
+	void remove_clip(clip_id id);
+
+	// Starts playing a clip on an entity, replacing the clip it played before.
+	void play(game_entity::entity_id id, const play_info& info);
+	void stop(game_entity::entity_id id);
+	bool is_playing(game_entity::entity_id id);
+
+	// Advances all animations by 'dt' and writes the animated values into the transforms.
+	void update(f32 dt);
+
+	namespace detail
+	{
+		// Animations of one world. See World.h.
+		struct world_data;
+		world_data* create_world();
+		void remove_world(world_data* const data);
+		void set_current_world(world_data* const data);
+
+		// World snapshots. See world::save_snapshot(). Clips are assets and aren't part of snapshots,
+		// so a clip must not be removed while a snapshot that plays it can still be restored.
+		u64 snapshot_size(const world_data* const data);
+		void save_world(const world_data* const data, utl::blob_stream_writer& writer);
+		void restore_world(world_data* const data, utl::blob_stream_reader& reader);
+	}
+}
@@ -1,3 +1,4 @@
 #pragma once
 #include "../Common/CommonHeaders.h"
-#include "../EngineAPI/GameEntity.h"
\ No newline at end of file
+#include "../EngineAPI/GameEntity.h"
+#include "../Utilities/IOStream.h"
\ No newline at end of file
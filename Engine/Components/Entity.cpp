@@ -1,103 +1,570 @@
+#include <algorithm>
 #include "Entity.h"
 #include "Transform.h"
 #include "Script.h"
+#include "Spatial.h"
+#include "Animation.h"
+#include "World.h"
 
 namespace havana::game_entity
 {
 	namespace // anonymous namespace
 	{
-		utl::vector<transform::component>	transforms;
-		utl::vector<script::component>		scripts;
-		utl::vector<id::generation_type>	generations;
-		utl::deque<entity_id>				free_ids;
-	}
-	
-	entity
-	create(entity_info info)
+		constexpr u32 chunk_size{ 16 * 1024 };
+
+		// NOTE: the order must match component_type.
+		constexpr u32 component_sizes[]
+		{
+			sizeof(transform::component),
+			sizeof(script::component),
+		};
+		static_assert(_countof(component_sizes) == component_type::count);
+
+		// Entities of an archetype are packed into chunks of 'capacity' rows. A chunk starts
+		// with the ids of its entities, followed by one column per component of the archetype.
+		struct archetype
+		{
+			component_mask							mask{ 0 };
+			u32										capacity{ 0 };
+			u32										count{ 0 };
+			u32										offsets[component_type::count]{};
+			utl::vector<std::unique_ptr<u8[]>>		chunks;
+		};
+
+		// Where an entity lives in the archetype storage.
+		struct entity_location
+		{
+			u32										archetype;
+			u32										row;
+		};
+	} // anonymous namespace
+
+	namespace detail
 	{
-		assert(info.transform); // All entities must have a transform component
-		if (!info.transform) return entity{};
+		struct world_data
+		{
+			utl::vector<archetype>					archetypes;
+			utl::handle_pool<entity_location>		entity_pool;
+		};
+	} // detail namespace
+
+	namespace // anonymous namespace
+	{
+		using detail::world_data;
+
+		// NOTE: null until the thread first uses the entity system or makes a world current.
+		thread_local world_data*					current_world{ nullptr };
+
+		world_data&
+		current()
+		{
+			if (!current_world) world::set_current(world::default_world());
+			return *current_world;
+		}
+
+		u32
+		get_archetype(world_data& state, component_mask mask)
+		{
+			// NOTE: there are only a handful of archetypes, so a linear search is fine.
+			for (u32 i{ 0 }; i < state.archetypes.size(); ++i)
+			{
+				if (state.archetypes[i].mask == mask) return i;
+			}
+
+			archetype& type{ state.archetypes.emplace_back() };
+			type.mask = mask;
+
+			u32 row_size{ sizeof(entity_id) };
+			for (u32 i{ 0 }; i < component_type::count; ++i)
+			{
+				if (mask & component_bit((component_type::type)i)) row_size += component_sizes[i];
+			}
+
+			type.capacity = chunk_size / row_size;
+			u32 offset{ type.capacity * (u32)sizeof(entity_id) };
+			for (u32 i{ 0 }; i < component_type::count; ++i)
+			{
+				if (mask & component_bit((component_type::type)i))
+				{
+					type.offsets[i] = offset;
+					offset += type.capacity * component_sizes[i];
+				}
+				else
+				{
+					type.offsets[i] = u32_invalid_id;
+				}
+			}
+			assert(offset <= chunk_size);
+
+			return (u32)state.archetypes.size() - 1;
+		}
+
+		template<typename T>
+		T*
+		get_column(const archetype& type, u32 chunk, component_type::type component)
+		{
+			assert(chunk < type.chunks.size());
+			const u32 offset{ type.offsets[component] };
+			return offset != u32_invalid_id ? (T*)&type.chunks[chunk][offset] : nullptr;
+		}
+
+		entity_id*
+		get_ids(const archetype& type, u32 chunk)
+		{
+			assert(chunk < type.chunks.size());
+			return (entity_id*)type.chunks[chunk].get();
+		}
+
+		u32
+		get_chunks_in_use(const archetype& type)
+		{
+			return (type.count + type.capacity - 1) / type.capacity;
+		}
+
+		u32
+		add_row(archetype& type, entity_id id)
+		{
+			const u32 row{ type.count };
+			const u32 chunk{ row / type.capacity };
+			if (chunk == type.chunks.size())
+			{
+				type.chunks.emplace_back(std::make_unique<u8[]>(chunk_size));
+			}
 
-		entity_id id;
+			get_ids(type, chunk)[row % type.capacity] = id;
+			++type.count;
+			return row;
+		}
 
-		if (free_ids.size() > id::min_deleted_elements)
+		void
+		remove_row(world_data& state, archetype& type, u32 row)
 		{
-			id = free_ids.front();
-			assert(!is_alive(id));
-			free_ids.pop_front();
-			id = entity_id{ id::new_generation(id) };
-			++generations[id::index(id)];
+			assert(row < type.count);
+			const u32 last{ type.count - 1 };
+			const u32 chunk{ row / type.capacity };
+			const u32 index{ row % type.capacity };
+
+			if (row != last)
+			{
+				// Move the last entity into the hole to keep the chunks dense.
+				const u32 last_chunk{ last / type.capacity };
+				const u32 last_index{ last % type.capacity };
+				const entity_id moved_id{ get_ids(type, last_chunk)[last_index] };
+				get_ids(type, chunk)[index] = moved_id;
+
+				for (u32 i{ 0 }; i < component_type::count; ++i)
+				{
+					const u32 offset{ type.offsets[i] };
+					if (offset == u32_invalid_id) continue;
+					const u32 size{ component_sizes[i] };
+					memcpy(&type.chunks[chunk][offset + index * size], &type.chunks[last_chunk][offset + last_index * size], size);
+				}
+
+				state.entity_pool[moved_id].row = row;
+			}
+
+			--type.count;
+
+			// Keep one empty chunk around, so an entity that is added and removed
+			// over and over at a chunk boundary doesn't allocate every time.
+			const u32 chunks_in_use{ get_chunks_in_use(type) };
+			if (type.chunks.size() > chunks_in_use + 1)
+			{
+				type.chunks.resize(chunks_in_use + 1);
+			}
 		}
-		else
+	} // anonymous namespace
+
+	namespace detail
+	{
+		world_data*
+		create_world()
 		{
-			id = entity_id{ (id::id_type)generations.size() };
-			generations.push_back(0);
+			return new world_data{};
+		}
 
-			// Resize components vector to match the amount of entities
-			// Using emplace_back() over resize() reduces the amount of memory allocations
-			transforms.emplace_back();
-			scripts.emplace_back();
+		void
+		remove_world(world_data* const data)
+		{
+			assert(data);
+			delete data;
 		}
 
+		void
+		set_current_world(world_data* const data)
+		{
+			current_world = data;
+		}
+
+		u64
+		snapshot_size(const world_data* const data)
+		{
+			assert(data);
+			u64 size{ sizeof(u32) + data->entity_pool.snapshot_size() };
+			for (const auto& type : data->archetypes)
+			{
+				size += sizeof(type.mask) + sizeof(type.capacity) + sizeof(type.count) + sizeof(type.offsets);
+				size += (u64)get_chunks_in_use(type) * chunk_size;
+			}
+
+			return size;
+		}
+
+		void
+		save_world(const world_data* const data, utl::blob_stream_writer& writer)
+		{
+			assert(data);
+			writer.write((u32)data->archetypes.size());
+			for (const auto& type : data->archetypes)
+			{
+				writer.write(type.mask);
+				writer.write(type.capacity);
+				writer.write(type.count);
+				writer.write((const u8*)&type.offsets[0], sizeof(type.offsets));
+
+				// NOTE: chunks are copied as a whole. Rows past 'count' hold stale but harmless data.
+				const u32 chunk_count{ get_chunks_in_use(type) };
+				for (u32 i{ 0 }; i < chunk_count; ++i)
+				{
+					writer.write(type.chunks[i].get(), chunk_size);
+				}
+			}
+
+			data->entity_pool.save(writer);
+		}
+
+		void
+		restore_world(world_data* const data, utl::blob_stream_reader& reader)
+		{
+			assert(data);
+			data->archetypes.resize(reader.read<u32>());
+			for (auto& type : data->archetypes)
+			{
+				type.mask = reader.read<component_mask>();
+				type.capacity = reader.read<u32>();
+				type.count = reader.read<u32>();
+				reader.read((u8*)&type.offsets[0], sizeof(type.offsets));
+
+				// NOTE: existing chunks are reused, so restoring the same world over and over doesn't allocate.
+				const u32 chunk_count{ get_chunks_in_use(type) };
+				while (type.chunks.size() < chunk_count)
+				{
+					type.chunks.emplace_back(std::make_unique<u8[]>(chunk_size));
+				}
+				if (type.chunks.size() > chunk_count + 1) type.chunks.resize(chunk_count + 1);
+
+				for (u32 i{ 0 }; i < chunk_count; ++i)
+				{
+					reader.read(type.chunks[i].get(), chunk_size);
+				}
+			}
+
+			data->entity_pool.restore(reader);
+		}
+	} // detail namespace
+
+	entity
+	create(entity_info info)
+	{
+		assert(info.transform); // All entities must have a transform component
+		if (!info.transform) return entity{};
+		// NOTE: scripts that are being updated must use create_deferred().
+		assert(!script::detail::is_updating());
+
+		world_data& state{ current() };
+		const entity_id id{ state.entity_pool.add() };
 		const entity new_entity{ id };
-		const id::id_type index{ id::index(id) };
 
 		// Create transform component
-		assert(!transforms[index].is_valid());
-		transforms[index] = transform::create(*info.transform, new_entity);
-		if (!transforms[index].is_valid()) return {};
-		
+		const transform::component transform_component{ transform::create(*info.transform, new_entity) };
+		if (!transform_component.is_valid())
+		{
+			state.entity_pool.remove(id);
+			return {};
+		}
+
+		const bool has_script{ info.script && info.script->script_creator };
+		const component_mask mask{ component_bit(component_type::transform) | (has_script ? component_bit(component_type::script) : 0) };
+		const u32 type_index{ get_archetype(state, mask) };
+		archetype& type{ state.archetypes[type_index] };
+		const u32 row{ add_row(type, id) };
+		state.entity_pool[id] = entity_location{ type_index, row };
+
+		const u32 chunk{ row / type.capacity };
+		const u32 index{ row % type.capacity };
+		get_column<transform::component>(type, chunk, component_type::transform)[index] = transform_component;
+
 		// Create script component
-		if (info.script && info.script->script_creator)
+		if (has_script)
 		{
-			assert(!scripts[index].is_valid());
-			scripts[index] = script::create(*info.script, new_entity);
-			assert(scripts[index].is_valid());
+			// NOTE: the script's constructor may look up the script of this entity,
+			//		 so we have to store an invalid one before it runs.
+			get_column<script::component>(type, chunk, component_type::script)[index] = {};
+			const script::component script_component{ script::create(*info.script, new_entity) };
+			assert(script_component.is_valid());
+
+			// NOTE: the constructor may create or remove entities, which can move our row or add archetypes.
+			const entity_location location{ state.entity_pool[id] };
+			const archetype& script_type{ state.archetypes[location.archetype] };
+			get_column<script::component>(script_type, location.row / script_type.capacity, component_type::script)[location.row % script_type.capacity] = script_component;
 		}
 
 		return new_entity;
 	}
 
+	void
+	create_deferred(const entity_info& info)
+	{
+		assert(info.transform);
+		if (script::detail::is_updating()) script::detail::defer_create(info);
+		else create(info);
+	}
+
 	void
 	remove(entity_id id)
 	{
-		const id::id_type index{ id::index(id) };
+		world_data& state{ current() };
 		assert(is_alive(id));
+		if (script::detail::is_updating())
+		{
+			// Scripts run on several threads, so they can't change the entity storage right away.
+			script::detail::defer_remove(id);
+			return;
+		}
 
-		if (scripts[index].is_valid())
+		const entity removed_entity{ id };
+
+		const script::component script_component{ removed_entity.script() };
+		if (script_component.is_valid())
 		{
-			script::remove(scripts[index]);
-			scripts[index] = {};
+			script::remove(script_component);
 		}
 
-		transform::remove(transforms[index]);
-		transforms[index] = {};
-		free_ids.push_back(id);
+		transform::remove(removed_entity.transform());
+		spatial::remove(id);
+		animation::stop(id);
+
+		const entity_location location{ state.entity_pool[id] };
+		remove_row(state, state.archetypes[location.archetype], location.row);
+		state.entity_pool.remove(id);
+	}
+
+	void
+	create_batch(const entity_info* const infos, u32 count, entity* const entities)
+	{
+		assert(infos && count && entities);
+		assert(!script::detail::is_updating());
+		world_data& state{ current() };
+
+		state.entity_pool.reserve(count);
+		u32 script_count{ 0 };
+		for (u32 i{ 0 }; i < count; ++i)
+		{
+			assert(infos[i].transform); // All entities must have a transform component
+			entities[i] = entity{ entity_id{ state.entity_pool.add() } };
+			if (infos[i].script && infos[i].script->script_creator) ++script_count;
+		}
+
+		// NOTE: transforms are stored by entity index, so they need room for every entity slot.
+		//		 Entities that share the same init_info one after another are created in one call.
+		transform::reserve(state.entity_pool.capacity());
+		for (u32 first{ 0 }, last{ 0 }; first < count; first = last)
+		{
+			while (++last < count && infos[last].transform == infos[first].transform) {}
+			transform::create_batch(*infos[first].transform, &entities[first], last - first, nullptr);
+		}
+
+		// Add the rows of each archetype in one pass, so it's looked up only once.
+		for (u32 group{ 0 }; group < 2; ++group)
+		{
+			const bool has_script{ group != 0 };
+			if ((has_script ? script_count : count - script_count) == 0) continue;
+
+			const component_mask mask{ component_bit(component_type::transform) | (has_script ? component_bit(component_type::script) : 0) };
+			const u32 type_index{ get_archetype(state, mask) };
+			archetype& type{ state.archetypes[type_index] };
+
+			for (u32 i{ 0 }; i < count; ++i)
+			{
+				if ((infos[i].script && infos[i].script->script_creator) != has_script) continue;
+
+				const entity_id id{ entities[i].get_id() };
+				const u32 row{ add_row(type, id) };
+				state.entity_pool[id] = entity_location{ type_index, row };
+
+				const u32 chunk{ row / type.capacity };
+				const u32 index{ row % type.capacity };
+				get_column<transform::component>(type, chunk, component_type::transform)[index] = transform::component{ transform::transform_id{ id } };
+				// NOTE: see create(). Scripts may look up the scripts of other entities while they're constructed.
+				if (has_script) get_column<script::component>(type, chunk, component_type::script)[index] = {};
+			}
+		}
+
+		if (script_count)
+		{
+			script::reserve(script_count);
+			utl::vector<script::component> scripts;
+			scripts.resize(count);
+			for (u32 first{ 0 }, last{ 0 }; first < count; first = last)
+			{
+				while (++last < count && infos[last].script == infos[first].script) {}
+				const script::init_info* const info{ infos[first].script };
+				if (info && info->script_creator) script::create_batch(*info, &entities[first], last - first, &scripts[first]);
+			}
+
+			for (u32 i{ 0 }; i < count; ++i)
+			{
+				if (!scripts[i].is_valid()) continue;
+				// NOTE: script constructors may create or remove entities, which can move our rows.
+				const entity_location location{ state.entity_pool[entities[i].get_id()] };
+				const archetype& script_type{ state.archetypes[location.archetype] };
+				get_column<script::component>(script_type, location.row / script_type.capacity, component_type::script)[location.row % script_type.capacity] = scripts[i];
+			}
+		}
+	}
+
+	void
+	instantiate(const entity_info& info, u32 count, entity* const entities, const math::v3* const positions)
+	{
+		assert(info.transform && count && entities);
+		if (!info.transform) return;
+		assert(!script::detail::is_updating());
+
+		world_data& state{ current() };
+		state.entity_pool.reserve(count);
+		for (u32 i{ 0 }; i < count; ++i)
+		{
+			entities[i] = entity{ entity_id{ state.entity_pool.add() } };
+		}
+
+		transform::create_batch(*info.transform, entities, count, positions);
+
+		const bool has_script{ info.script && info.script->script_creator };
+		const component_mask mask{ component_bit(component_type::transform) | (has_script ? component_bit(component_type::script) : 0) };
+		const u32 type_index{ get_archetype(state, mask) };
+		archetype& type{ state.archetypes[type_index] };
+
+		for (u32 i{ 0 }; i < count; ++i)
+		{
+			const entity_id id{ entities[i].get_id() };
+			const u32 row{ add_row(type, id) };
+			state.entity_pool[id] = entity_location{ type_index, row };
+
+			const u32 chunk{ row / type.capacity };
+			const u32 index{ row % type.capacity };
+			get_column<transform::component>(type, chunk, component_type::transform)[index] = transform::component{ transform::transform_id{ id } };
+			// NOTE: see create(). Scripts may look up the scripts of other instances while they're constructed.
+			if (has_script) get_column<script::component>(type, chunk, component_type::script)[index] = {};
+		}
+
+		if (has_script)
+		{
+			utl::vector<script::component> scripts;
+			scripts.resize(count);
+			script::create_batch(*info.script, entities, count, scripts.data());
+
+			for (u32 i{ 0 }; i < count; ++i)
+			{
+				// NOTE: script constructors may create or remove entities, which can move our rows.
+				const entity_location location{ state.entity_pool[entities[i].get_id()] };
+				const archetype& script_type{ state.archetypes[location.archetype] };
+				get_column<script::component>(script_type, location.row / script_type.capacity, component_type::script)[location.row % script_type.capacity] = scripts[i];
+			}
+		}
+	}
+
+	void
+	remove_batch(const entity* const entities, u32 count)
+	{
+		assert(entities && count);
+		if (script::detail::is_updating())
+		{
+			// NOTE: see remove(). The removals are queued and applied after the update.
+			for (u32 i{ 0 }; i < count; ++i) remove(entities[i].get_id());
+			return;
+		}
+
+		world_data& state{ current() };
+		utl::vector<entity_location> locations;
+		locations.reserve(count);
+		for (u32 i{ 0 }; i < count; ++i)
+		{
+			const entity_id id{ entities[i].get_id() };
+			assert(is_alive(id));
+			const script::component script_component{ entities[i].script() };
+			if (script_component.is_valid())
+			{
+				script::remove(script_component);
+			}
+
+			transform::remove(entities[i].transform());
+			spatial::remove(id);
+			animation::stop(id);
+			locations.emplace_back(state.entity_pool[id]);
+		}
+
+		// Rows are removed from the back of each archetype. That way, the row that fills a hole is
+		// never one that still has to be removed, and the locations we collected stay valid.
+		std::sort(locations.begin(), locations.end(), [](const entity_location& a, const entity_location& b)
+				  {
+					  return a.archetype != b.archetype ? a.archetype < b.archetype : a.row > b.row;
+				  });
+		for (const entity_location& location : locations)
+		{
+			remove_row(state, state.archetypes[location.archetype], location.row);
+		}
+
+		for (u32 i{ 0 }; i < count; ++i)
+		{
+			state.entity_pool.remove(entities[i].get_id());
+		}
 	}
 
 	bool
 	is_alive(entity_id id)
 	{
-		assert(id::is_valid(id));
-		const id::id_type index{ id::index(id) };
-		assert(index < generations.size());
-		return (generations[index] == id::generation(id) && transforms[index].is_valid());
+		return current().entity_pool.is_alive(id);
+	}
+
+	void
+	get_chunks(component_mask mask, utl::vector<entity_chunk>& chunks)
+	{
+		world_data& state{ current() };
+		chunks.clear();
+		for (const auto& type : state.archetypes)
+		{
+			if ((type.mask & mask) != mask) continue;
+
+			for (u32 begin{ 0 }, chunk{ 0 }; begin < type.count; begin += type.capacity, ++chunk)
+			{
+				entity_chunk& c{ chunks.emplace_back() };
+				c.ids = get_ids(type, chunk);
+				c.transforms = get_column<transform::component>(type, chunk, component_type::transform);
+				c.scripts = get_column<script::component>(type, chunk, component_type::script);
+				c.count = type.count - begin < type.capacity ? type.count - begin : type.capacity;
+			}
+		}
 	}
 
 	// Entity class method implementations
 	transform::component
 	entity::transform() const
 	{
+		world_data& state{ current() };
 		assert(is_alive(_id));
-		const id::id_type index{ id::index(_id) };
-		return transforms[index];
+		const entity_location location{ state.entity_pool[_id] };
+		const archetype& type{ state.archetypes[location.archetype] };
+		return get_column<transform::component>(type, location.row / type.capacity, component_type::transform)[location.row % type.capacity];
 	}
 
 	script::component
 	entity::script() const
 	{
+		world_data& state{ current() };
 		assert(is_alive(_id));
-		const id::id_type index{ id::index(_id) };
-		return scripts[index];
+		const entity_location location{ state.entity_pool[_id] };
+		const archetype& type{ state.archetypes[location.archetype] };
+		const script::component* const scripts{ get_column<script::component>(type, location.row / type.capacity, component_type::script) };
+		return scripts ? scripts[location.row % type.capacity] : script::component{};
 	}
 }
\ No newline at end of file
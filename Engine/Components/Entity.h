@@ -19,8 +19,72 @@ namespace havana
 			script::init_info* script{ nullptr };
 		};
 
+		// Entities are grouped by the set of components they have (their archetype) and
+		// stored in fixed-size chunks, so only the components that exist take up memory.
+		namespace component_type
+		{
+			enum type : u32
+			{
+				transform,
+				script,
+
+				count
+			};
+		}
+
+		using component_mask = u32;
+		constexpr component_mask component_bit(component_type::type type) { return component_mask{ 1 } << type; }
+
+		// A dense block of entities that share the same archetype. Columns of components
+		// the archetype doesn't have are null.
+		struct entity_chunk
+		{
+			const entity_id*				ids{ nullptr };
+			const transform::component*		transforms{ nullptr };
+			const script::component*		scripts{ nullptr };
+			u32								count{ 0 };
+		};
+
+		// NOTE: scripts are updated on several threads (see script::update()), so the entity storage can't
+		//		 change while they run. Scripts that create entities in update() must use create_deferred().
+		//		 remove() can be called from scripts, but the entity stays alive until the update of the
+		//		 current tick group is done.
 		entity create(entity_info info);
+		// Same as create(), except that during script::update() the entity is created after the update of the
+		// current tick group. Its id isn't known before then, so nothing is returned.
+		void create_deferred(const entity_info& info);
 		void remove(entity_id id);
 		bool is_alive(entity_id id);
+
+		// Creates 'count' entities and writes them to 'entities'. Component storage is reserved once for the
+		// whole batch, entities are added to each archetype in one pass, and neighbouring entities that share
+		// the same init_info get their components in one call, like in instantiate().
+		void create_batch(const entity_info* const infos, u32 count, entity* const entities);
+		// Removes 'count' entities. Their rows are removed from the back of each archetype, so only the
+		// rows of entities that stay alive are moved to fill the holes.
+		void remove_batch(const entity* const entities, u32 count);
+
+		// Creates 'count' copies of the same entity, e.g. the instances of a prefab. The component data is
+		// prepared once and copied into the component storage, and the script pool is looked up only once.
+		// 'positions' is optional and replaces the position of info.transform for each copy.
+		void instantiate(const entity_info& info, u32 count, entity* const entities, const math::v3* const positions = nullptr);
+
+		// Fills 'chunks' with every non-empty chunk of entities that have at least the components in 'mask'.
+		// The chunks are valid until the next entity is created or removed.
+		void get_chunks(component_mask mask, utl::vector<entity_chunk>& chunks);
+
+		namespace detail
+		{
+			// Entity storage of one world. See World.h.
+			struct world_data;
+			world_data* create_world();
+			void remove_world(world_data* const data);
+			void set_current_world(world_data* const data);
+
+			// World snapshots. See world::save_snapshot().
+			u64 snapshot_size(const world_data* const data);
+			void save_world(const world_data* const data, utl::blob_stream_writer& writer);
+			void restore_world(world_data* const data, utl::blob_stream_reader& reader);
+		}
 	}
 }
\ No newline at end of file
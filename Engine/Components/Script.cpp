@@ -1,23 +1,157 @@
+#include <algorithm>
 #include "Script.h"
 #include "Entity.h"
 #include "Transform.h"
-
-#define USE_TRANSFORM_CACHE_MAP 1
+#include "World.h"
+#include "Jobs/Jobs.h"
+#include "Core/FrameMemory.h"
+#include "EngineAPI/Input.h"
 
 namespace havana::script
 {
 	namespace // anonymous namespace
 	{
-		utl::vector<detail::script_ptr>			entity_scripts;
-		utl::vector<id::id_type>				id_mapping;
+		// A transform change requested by a script. 'order' is the position of the batch of
+		// scripts that made the change in the update order (0 for changes made outside of update()),
+		// which lets us merge the per-thread caches in the same order as a serial update would.
+		// NOTE: each batch runs on a single thread, so changes within a batch are already in order.
+		struct transform_write
+		{
+			transform::component_cache	cache;
+			u32							order;
+		};
+
+		// Scripts of one class are stored in chunks of about this many bytes. Chunks never move,
+		// so scripts keep their address for as long as they live.
+		constexpr u32							chunk_size{ 16 * 1024 };
+
+		// All scripts of one class in one tick group. A slot of a removed script stays empty until it's reused.
+		struct script_pool
+		{
+			detail::script_creator					creator{ nullptr };
+			const detail::script_type*				type{ nullptr };
+			tick_group::group						group{ tick_group::pre_transform };
+			u32										capacity{ 0 };	// scripts per chunk
+			utl::vector<std::unique_ptr<u8[]>>		chunks;
+			utl::vector<u32>						awake_counts;	// per chunk
+			utl::vector<u8>							alive;
+			utl::vector<u8>							awake;
+			utl::vector<u32>						sleep_counts;	// tells apart the waits of a slot
+			utl::vector<u32>						free_slots;
+			utl::vector<f32>						intervals;
+			utl::vector<f32>						elapsed;	// time since the last update
+			utl::vector<f32>						countdowns;	// time until the next update
+			// NOTE: these are filled in just before the update of each chunk.
+			utl::vector<u8>							ticks;
+			utl::vector<f32>						dts;
+		};
+
+		// Where a script lives.
+		struct script_location
+		{
+			u32										pool;
+			u32										slot;
+		};
+
+		// A chunk of scripts that's updated as one job.
+		struct script_batch
+		{
+			script_pool*							pool;
+			u32										chunk;
+			u32										count;
+		};
 
-		utl::vector<id::generation_type>		generations;
-		utl::deque<script_id>					free_ids;
+		struct wait_type
+		{
+			enum type : u32
+			{
+				event,
+				time,
+				frames,
+				input,
+			};
+		};
 
-		utl::vector<transform::component_cache>	transform_cache;
-#if USE_TRANSFORM_CACHE_MAP
-		std::unordered_map<id::id_type, u32>	cache_map;
-#endif
+		// A script that asked to go to sleep during an update. We use the entity id, because
+		// scripts can ask from their constructor, before their script id is known.
+		struct sleep_request
+		{
+			game_entity::entity_id					entity;
+			wait_type::type							type;
+			u64										until;		// time in microseconds or frame
+			u64										binding;
+		};
+
+		// A sleeping script that's waiting for something. 'sleep_count' has to match the
+		// slot's current count, otherwise the script has been woken up (or removed) since.
+		struct script_wait
+		{
+			u64										until;
+			script_id								id;
+			u32										sleep_count;
+		};
+
+		// An entity that a script created or removed during an update. Scripts run on several threads,
+		// so these are applied after the update of the tick group, like transform writes.
+		struct entity_command
+		{
+			game_entity::entity_id					remove_id;	// invalid for entities that are created
+			transform::init_info					transform;
+			init_info								script;
+			bool									has_script;
+		};
+
+		class input_listener;
+	} // anonymous namespace
+
+	namespace detail
+	{
+		struct world_data
+		{
+			utl::vector<script_pool>				script_pools;
+			utl::handle_pool<script_location>		id_mapping;
+			utl::vector<script_batch>				script_batches;
+
+			// NOTE: timers are kept in min-heaps sorted by 'until'.
+			utl::vector<script_wait>				time_waits;
+			utl::vector<script_wait>				frame_waits;
+			std::unordered_map<u64, utl::vector<script_wait>>	input_waits;
+			std::unique_ptr<input_listener>			listener;
+			utl::vector<utl::vector<sleep_request>>	thread_sleep_requests;
+			utl::vector<script_wait>				pending_wakes;
+			std::mutex								pending_wakes_mutex;
+			u64										current_time{ 0 };	// in microseconds
+			u64										current_frame{ 0 };
+
+			// NOTE: each thread that runs scripts writes only to its own cache, indexed by jobs::thread_index().
+			utl::vector<utl::vector<transform_write>>	thread_caches;
+			utl::vector<utl::vector<entity_command>>	thread_commands;
+			bool										is_updating{ false };
+		};
+	} // detail namespace
+
+	namespace // anonymous namespace
+	{
+		using detail::world_data;
+
+		// NOTE: null until the thread first uses the script system or makes a world current.
+		thread_local world_data*					current_world{ nullptr };
+		thread_local u32							write_order{ 0 };
+
+		// A tick group of one world, updated by several jobs.
+		struct update_job_data
+		{
+			world::detail::world_state*				world;
+			world_data*								state;
+			f32										dt;
+		};
+
+		world_data&
+		current()
+		{
+			if (!current_world) world::set_current(world::default_world());
+			return *current_world;
+		}
 
 		using script_registry = std::unordered_map<size_t, detail::script_creator>;
 
@@ -44,65 +178,411 @@ namespace havana::script
 #endif // USE_WITH_EDITOR
 
 
+		void* const
+		get_memory(const script_pool& pool, u32 slot)
+		{
+			assert(slot < pool.alive.size());
+			return &pool.chunks[slot / pool.capacity][(slot % pool.capacity) * pool.type->size];
+		}
+
+		void
+		set_awake(script_pool& pool, u32 slot, bool is_awake)
+		{
+			if (pool.awake[slot] == (u8)is_awake) return;
+			pool.awake[slot] = (u8)is_awake;
+			u32& count{ pool.awake_counts[slot / pool.capacity] };
+			count = is_awake ? count + 1 : count - 1;
+			// NOTE: scripts that just woke up run in the next update, regardless of their tick interval.
+			if (is_awake)
+			{
+				pool.elapsed[slot] = pool.intervals[slot];
+				pool.countdowns[slot] = 0.f;
+			}
+		}
+
+		u32
+		get_pool(world_data& state, detail::script_creator creator, tick_group::group group)
+		{
+			// NOTE: there are only a handful of script classes, so a linear search is fine.
+			for (u32 i{ 0 }; i < state.script_pools.size(); ++i)
+			{
+				if (state.script_pools[i].creator == creator && state.script_pools[i].group == group) return i;
+			}
+
+			script_pool& pool{ state.script_pools.emplace_back() };
+			pool.creator = creator;
+			pool.group = group;
+			pool.type = creator();
+			assert(pool.type && pool.type->size);
+			// NOTE: new[] only guarantees the default new alignment.
+			assert(pool.type->alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+			pool.capacity = std::max(chunk_size / pool.type->size, 1u);
+			return (u32)state.script_pools.size() - 1;
+		}
+
+		component
+		add_script(world_data& state, u32 pool_index, const init_info& info, game_entity::entity entity)
+		{
+			assert(entity.is_valid());
+			script_pool& pool{ state.script_pools[pool_index] };
+
+			u32 slot{ u32_invalid_id };
+			if (!pool.free_slots.empty())
+			{
+				slot = pool.free_slots.back();
+				pool.free_slots.resize(pool.free_slots.size() - 1);
+			}
+			else
+			{
+				slot = (u32)pool.alive.size();
+				if (slot == pool.chunks.size() * pool.capacity)
+				{
+					pool.chunks.emplace_back(std::make_unique<u8[]>(pool.capacity * pool.type->size));
+					pool.awake_counts.emplace_back(0);
+				}
+				pool.alive.emplace_back((u8)0);
+				pool.awake.emplace_back((u8)0);
+				pool.sleep_counts.emplace_back(0);
+				pool.intervals.emplace_back();
+				pool.elapsed.emplace_back();
+				pool.countdowns.emplace_back();
+				pool.ticks.emplace_back();
+				pool.dts.emplace_back();
+			}
+
+			pool.intervals[slot] = info.tick_interval;
+
+			const script_id id{ state.id_mapping.add(script_location{ pool_index, slot }) };
+			assert(id::is_valid(id));
+			[[maybe_unused]] const entity_script* const script{ pool.type->construct(get_memory(pool, slot), entity) };
+			assert(script->get_id() == entity.get_id());
+
+			// NOTE: the constructor may create scripts of other classes, which can add pools and move ours.
+			script_pool& constructed_pool{ state.script_pools[pool_index] };
+			constructed_pool.alive[slot] = 1;
+			set_awake(constructed_pool, slot, true);
+
+			// NOTE: we start scripts with the same interval at different points of their interval,
+			//		 so they don't all run in the same frame. Their first 'dt' is still the time since
+			//		 they were created.
+			constexpr f32 golden_ratio_fraction{ 0.618034f };
+			const f32 phase{ (f32)slot * golden_ratio_fraction };
+			constructed_pool.elapsed[slot] = 0.f;
+			constructed_pool.countdowns[slot] = constructed_pool.intervals[slot] * (phase - (f32)(u32)phase);
+			return component{ id };
+		}
+
 		bool
-			exists(script_id id)
+			exists(world_data& state, script_id id)
 		{
 			assert(id::is_valid(id));
-			const id::id_type index{ id::index(id) };
-			assert(index < generations.size() && id_mapping[index] < entity_scripts.size());
-			assert(generations[id] == id::generation(id));
-			return (generations[id] == id::generation(id)) &&
-				entity_scripts[id_mapping[index]] &&
-				entity_scripts[id_mapping[index]]->is_valid();
+			if (!state.id_mapping.is_alive(id)) return false;
+			const script_location location{ state.id_mapping[id] };
+			const script_pool& pool{ state.script_pools[location.pool] };
+			return pool.alive[location.slot] && ((const entity_script*)get_memory(pool, location.slot))->is_valid();
 		}
 
-#if USE_TRANSFORM_CACHE_MAP
 		transform::component_cache* const
-			get_cache_ptr(const game_entity::entity* const entity)
+		get_cache_ptr(world_data& state, const game_entity::entity* const entity)
 		{
 			assert(game_entity::is_alive((*entity).get_id()));
 			const transform::transform_id id{ (*entity).transform().get_id() };
+			const u32 thread_index{ jobs::thread_index() };
+			if (thread_index >= state.thread_caches.size())
+			{
+				// NOTE: update() sizes the caches before running any scripts, so we can only get here
+				//		 when a transform is set from outside of update() on the main thread.
+				assert(thread_index == 0);
+				state.thread_caches.resize(jobs::thread_count());
+			}
 
-			u32 index{ u32_invalid_id };
-			auto pair = cache_map.try_emplace(id, id::invalid_id);
+			utl::vector<transform_write>& cache{ state.thread_caches[thread_index] };
 
-			// cache_map didn't have an entry for this id, new entry inserted
-			if (pair.second)
+			// Scripts usually set several values of the same transform in a row,
+			// so we only need to check the last write to avoid duplicates.
+			if (!cache.empty() && cache.back().cache.id == id && cache.back().order == write_order)
 			{
-				index = (u32)transform_cache.size();
-				transform_cache.emplace_back();
-				transform_cache.back().id = id;
-				cache_map[id] = index;
+				return &cache.back().cache;
 			}
-			else
+
+			transform_write& write{ cache.emplace_back() };
+			write.cache.id = id;
+			write.order = write_order;
+			return &write.cache;
+		}
+
+		void
+		merge_transform_caches(world_data& state, memory::frame_vector<transform::component_cache>& transform_cache)
+		{
+			memory::frame_vector<transform_write> merged_writes;
+			for (auto& cache : state.thread_caches)
 			{
-				index = cache_map[id];
+				for (const auto& write : cache)
+				{
+					merged_writes.emplace_back(write);
+				}
+				cache.clear();
 			}
 
-			assert(index < transform_cache.size());
-			return &transform_cache[index];
+			if (merged_writes.empty()) return;
+
+			// NOTE: the sort has to be stable, because a script can write to the same transform more
+			//		 than once with the same order (e.g. when it alternates between two entities).
+			std::stable_sort(merged_writes.begin(), merged_writes.end(), [](const transform_write& a, const transform_write& b)
+			{
+				const id::id_type id_a{ a.cache.id };
+				const id::id_type id_b{ b.cache.id };
+				return id_a < id_b || (id_a == id_b && a.order < b.order);
+			});
+
+			assert(transform_cache.empty());
+			for (const auto& write : merged_writes)
+			{
+				const transform::component_cache& c{ write.cache };
+				if (transform_cache.empty() || transform_cache.back().id != c.id)
+				{
+					transform_cache.emplace_back(c);
+					continue;
+				}
+
+				// Combine with the previous writes to the same transform. Later writes win.
+				transform::component_cache& target{ transform_cache.back() };
+				if (c.flags & transform::component_flags::rotation) target.rotation = c.rotation;
+				if (c.flags & transform::component_flags::orientation) target.orientation = c.orientation;
+				if (c.flags & transform::component_flags::position) target.position = c.position;
+				if (c.flags & transform::component_flags::scale) target.scale = c.scale;
+				target.flags |= c.flags;
+			}
 		}
-#else
-		transform::component_cache* const
-		get_cache_ptr(const game_entity::entity* const entity)
+
+		void
+		update_scripts(void* const data, u32 begin, u32 end)
 		{
-			assert(game_entity::is_alive((*entity).get_id()));
-			const transform::transform_id id{ (*entity).transform().get_id() };
+			const update_job_data& job{ *(const update_job_data* const)data };
+			// NOTE: scripts use the entities and transforms of their world, whichever thread runs them.
+			world::scope world_scope{ job.world };
+			world_data& state{ *job.state };
+			const f32 dt{ job.dt };
+			for (u32 i{ begin }; i < end; ++i)
+			{
+				const script_batch& batch{ state.script_batches[i] };
+				script_pool& pool{ *batch.pool };
+				const u32 first{ batch.chunk * pool.capacity };
+				const u32 last{ first + batch.count };
+
+				// Find out which scripts are due this frame.
+				for (u32 slot{ first }; slot < last; ++slot)
+				{
+					const f32 elapsed{ pool.elapsed[slot] + dt };
+					const f32 countdown{ pool.countdowns[slot] - dt };
+					const bool tick{ pool.awake[slot] && countdown <= 0.f };
+					pool.ticks[slot] = (u8)tick;
+					pool.dts[slot] = elapsed;
+					pool.elapsed[slot] = tick ? 0.f : elapsed;
+					pool.countdowns[slot] = tick ? pool.intervals[slot] : countdown;
+				}
+
+				write_order = i + 1;
+				pool.type->update(pool.chunks[batch.chunk].get(), &pool.ticks[first], &pool.dts[first], batch.count);
+			}
+			write_order = 0;
+		}
+
+		class input_listener final : public input::detail::input_system_base
+		{
+		public:
+			explicit input_listener(world_data& state) : _state{ state } {}
+
+			void on_event(input::input_source::type, input::input_code::code, const input::input_value&) override {}
+
+			void on_event(u64 binding, const input::input_value&) override
+			{
+				auto waits{ _state.input_waits.find(binding) };
+				if (waits == _state.input_waits.end() || waits->second.empty()) return;
+
+				std::lock_guard lock{ _state.pending_wakes_mutex };
+				for (const auto& wait : waits->second)
+				{
+					_state.pending_wakes.emplace_back(wait);
+				}
+				waits->second.clear();
+			}
+
+		private:
+			world_data&		_state;
+		};
+
+		void
+		listen_to_input(world_data& state)
+		{
+			// NOTE: we create the listener on first use, because it registers itself with
+			//		 the input system, which has to be initialized first.
+			if (!state.listener) state.listener = std::make_unique<input_listener>(state);
+		}
 
-			for (auto& cache : transform_cache)
+		void
+		wake_script(world_data& state, const script_wait& wait)
+		{
+			if (!state.id_mapping.is_alive(wait.id)) return;
+			const script_location location{ state.id_mapping[wait.id] };
+			script_pool& pool{ state.script_pools[location.pool] };
+			if (wait.sleep_count != u32_invalid_id && wait.sleep_count != pool.sleep_counts[location.slot]) return;
+			set_awake(pool, location.slot, true);
+		}
+
+		void
+		push_wait(utl::vector<script_wait>& waits, const script_wait& wait)
+		{
+			waits.emplace_back(wait);
+			std::push_heap(waits.begin(), waits.end(), [](const script_wait& a, const script_wait& b) { return a.until > b.until; });
+		}
+
+		void
+		wake_due_scripts(world_data& state, utl::vector<script_wait>& waits, u64 now)
+		{
+			while (!waits.empty() && waits.front().until <= now)
+			{
+				wake_script(state, waits.front());
+				std::pop_heap(waits.begin(), waits.end(), [](const script_wait& a, const script_wait& b) { return a.until > b.until; });
+				waits.resize(waits.size() - 1);
+			}
+		}
+
+		void
+		wake_scripts(world_data& state)
+		{
+			wake_due_scripts(state, state.time_waits, state.current_time);
+			wake_due_scripts(state, state.frame_waits, state.current_frame);
+
+			std::lock_guard lock{ state.pending_wakes_mutex };
+			for (const auto& wait : state.pending_wakes)
+			{
+				wake_script(state, wait);
+			}
+			state.pending_wakes.clear();
+		}
+
+		void
+		put_scripts_to_sleep(world_data& state)
+		{
+			for (auto& requests : state.thread_sleep_requests)
 			{
-				if (cache.id == id)
+				for (const auto& request : requests)
 				{
-					return &cache;
+					if (!game_entity::is_alive(request.entity)) continue;
+					const script_id id{ game_entity::entity{ request.entity }.script().get_id() };
+					if (!id::is_valid(id)) continue;
+
+					const script_location location{ state.id_mapping[id] };
+					script_pool& pool{ state.script_pools[location.pool] };
+					set_awake(pool, location.slot, false);
+					const script_wait wait{ request.until, id, ++pool.sleep_counts[location.slot] };
+
+					switch (request.type)
+					{
+					case wait_type::event: break;
+					case wait_type::time: push_wait(state.time_waits, wait); break;
+					case wait_type::frames: push_wait(state.frame_waits, wait); break;
+					case wait_type::input:
+						listen_to_input(state);
+						state.input_waits[request.binding].emplace_back(wait);
+						break;
+					}
 				}
+				requests.clear();
 			}
+		}
 
-			transform_cache.emplace_back();
-			transform_cache.back().id = id;
+		void
+		request_sleep(world_data& state, const game_entity::entity* const entity, wait_type::type type, u64 until, u64 binding)
+		{
+			assert(entity->is_valid());
+			const u32 thread_index{ jobs::thread_index() };
+			if (thread_index >= state.thread_sleep_requests.size())
+			{
+				// NOTE: see get_cache_ptr().
+				assert(thread_index == 0);
+				state.thread_sleep_requests.resize(jobs::thread_count());
+			}
+
+			state.thread_sleep_requests[thread_index].emplace_back(sleep_request{ entity->get_id(), type, until, binding });
+		}
 
-			return &transform_cache.back();
+		utl::vector<entity_command>&
+		get_commands(world_data& state)
+		{
+			assert(state.is_updating);
+			const u32 thread_index{ jobs::thread_index() };
+			// NOTE: update() sizes the command buffers before running any scripts.
+			assert(thread_index < state.thread_commands.size());
+			return state.thread_commands[thread_index];
+		}
+
+		void
+		apply_entity_commands(world_data& state)
+		{
+			assert(!state.is_updating);
+			for (auto& commands : state.thread_commands)
+			{
+				for (u32 i{ 0 }; i < commands.size(); ++i)
+				{
+					// NOTE: constructors of the new scripts can't add commands, because no update is running.
+					entity_command& command{ commands[i] };
+					if (id::is_valid(command.remove_id))
+					{
+						// Several scripts may have removed the same entity.
+						if (game_entity::is_alive(command.remove_id)) game_entity::remove(command.remove_id);
+					}
+					else
+					{
+						game_entity::entity_info info{ &command.transform, command.has_script ? &command.script : nullptr };
+						game_entity::create(info);
+					}
+				}
+				commands.clear();
+			}
+		}
+
+		void
+		update_group(world_data& state, tick_group::group group, f32 dt)
+		{
+			// Scripts are updated class by class, one chunk per job.
+			state.script_batches.clear();
+			for (auto& pool : state.script_pools)
+			{
+				if (pool.group != group) continue;
+				const u32 slot_count{ (u32)pool.alive.size() };
+
+				for (u32 first{ 0 }, chunk{ 0 }; first < slot_count; first += pool.capacity, ++chunk)
+				{
+					// NOTE: chunks without awake scripts cost nothing.
+					if (!pool.awake_counts[chunk]) continue;
+					state.script_batches.emplace_back(script_batch{ &pool, chunk, std::min(pool.capacity, slot_count - first) });
+				}
+			}
+
+			const u32 count{ (u32)state.script_batches.size() };
+			if (count)
+			{
+				jobs::counter counter{};
+				update_job_data job{ world::detail::current_state(), &state, dt };
+				state.is_updating = true;
+				jobs::run(update_scripts, &job, count, 1, &counter);
+				jobs::wait(&counter);
+				state.is_updating = false;
+			}
+
+			memory::frame_vector<transform::component_cache> transform_cache;
+			merge_transform_caches(state, transform_cache);
+
+			if (transform_cache.size())
+			{
+				transform::update(transform_cache.data(), (u32)transform_cache.size());
+			}
+
+			put_scripts_to_sleep(state);
+			apply_entity_commands(state);
 		}
-#endif
 
 	} // anonymous namespace
 
@@ -125,6 +605,248 @@ namespace havana::script
 			return script->second;
 		}
 
+		world_data*
+		create_world()
+		{
+			return new world_data{};
+		}
+
+		void
+		remove_world(world_data* const data)
+		{
+			assert(data);
+			// NOTE: we don't remove scripts one by one, but their destructors still have to run.
+			destroy_scripts(data);
+			delete data;
+		}
+
+		void
+		set_current_world(world_data* const data)
+		{
+			current_world = data;
+		}
+
+		void
+		destroy_scripts(world_data* const data)
+		{
+			assert(data);
+			for (auto& pool : data->script_pools)
+			{
+				for (u32 slot{ 0 }; slot < pool.alive.size(); ++slot)
+				{
+					if (pool.alive[slot]) pool.type->destroy(get_memory(pool, slot));
+				}
+			}
+		}
+
+		u64
+		snapshot_size(const world_data* const data)
+		{
+			assert(data);
+			using writer = utl::blob_stream_writer;
+			u64 size{ data->id_mapping.snapshot_size() + sizeof(u32) };
+			for (const auto& pool : data->script_pools)
+			{
+				size += sizeof(pool.creator) + sizeof(u32) + writer::items_size(pool.alive);
+				size += sizeof(u64) + pool.alive.size() * sizeof(game_entity::entity_id);
+				size += writer::items_size(pool.awake_counts) + writer::items_size(pool.awake);
+				size += writer::items_size(pool.sleep_counts) + writer::items_size(pool.free_slots);
+				size += writer::items_size(pool.intervals) + writer::items_size(pool.elapsed) + writer::items_size(pool.countdowns);
+				if (!pool.type->has_snapshot) continue;
+
+				for (u32 slot{ 0 }; slot < pool.alive.size(); ++slot)
+				{
+					if (pool.alive[slot]) size += sizeof(u32) + ((const entity_script*)get_memory(pool, slot))->snapshot_size();
+				}
+			}
+
+			size += writer::items_size(data->time_waits) + writer::items_size(data->frame_waits) + sizeof(u32);
+			for (const auto& waits : data->input_waits) size += sizeof(waits.first) + writer::items_size(waits.second);
+			size += writer::items_size(data->pending_wakes) + sizeof(u64);
+			for (const auto& requests : data->thread_sleep_requests) size += requests.size() * sizeof(sleep_request);
+			size += sizeof(data->current_time) + sizeof(data->current_frame);
+			return size;
+		}
+
+		void
+		save_world(const world_data* const data, utl::blob_stream_writer& writer)
+		{
+			assert(data);
+			// NOTE: the id mapping comes first, because scripts are constructed while their pools are restored.
+			data->id_mapping.save(writer);
+			writer.write((u32)data->script_pools.size());
+			for (const auto& pool : data->script_pools)
+			{
+				// NOTE: creators are function pointers, so snapshots only work in the program that saved them.
+				writer.write((const u8*)&pool.creator, sizeof(pool.creator));
+				writer.write((u32)pool.group);
+				writer.write_items(pool.alive);
+				writer.write((u64)pool.alive.size());
+				for (u32 slot{ 0 }; slot < pool.alive.size(); ++slot)
+				{
+					const game_entity::entity_id id{ pool.alive[slot] ? ((const entity_script*)get_memory(pool, slot))->get_id() : game_entity::entity_id{ id::invalid_id } };
+					writer.write((const u8*)&id, sizeof(id));
+				}
+			}
+
+			for (const auto& pool : data->script_pools)
+			{
+				writer.write_items(pool.awake_counts);
+				writer.write_items(pool.awake);
+				writer.write_items(pool.sleep_counts);
+				writer.write_items(pool.free_slots);
+				writer.write_items(pool.intervals);
+				writer.write_items(pool.elapsed);
+				writer.write_items(pool.countdowns);
+				if (!pool.type->has_snapshot) continue;
+
+				for (u32 slot{ 0 }; slot < pool.alive.size(); ++slot)
+				{
+					if (!pool.alive[slot]) continue;
+					const entity_script* const script{ (const entity_script*)get_memory(pool, slot) };
+					const u32 size{ script->snapshot_size() };
+					writer.write(size);
+					script->save((u8*)writer.position());
+					writer.skip(size);
+				}
+			}
+
+			writer.write_items(data->time_waits);
+			writer.write_items(data->frame_waits);
+			writer.write((u32)data->input_waits.size());
+			for (const auto& waits : data->input_waits)
+			{
+				writer.write(waits.first);
+				writer.write_items(waits.second);
+			}
+			writer.write_items(data->pending_wakes);
+
+			// NOTE: sleep requests that were made outside of update() are handled in the next update.
+			u64 request_count{ 0 };
+			for (const auto& requests : data->thread_sleep_requests) request_count += requests.size();
+			writer.write(request_count);
+			for (const auto& requests : data->thread_sleep_requests)
+			{
+				if (requests.size()) writer.write((const u8*)requests.data(), requests.size() * sizeof(sleep_request));
+			}
+
+			writer.write(data->current_time);
+			writer.write(data->current_frame);
+		}
+
+		void
+		restore_world(world_data* const data, utl::blob_stream_reader& reader)
+		{
+			assert(data);
+			world_data& state{ *data };
+			state.id_mapping.restore(reader);
+			state.script_pools.resize(reader.read<u32>());
+			for (auto& pool : state.script_pools)
+			{
+				script_creator creator{ nullptr };
+				reader.read((u8*)&creator, sizeof(creator));
+				if (creator != pool.creator)
+				{
+					// NOTE: the chunks of the pool were made for scripts of another class.
+					pool.chunks.clear();
+					pool.creator = creator;
+					pool.type = creator();
+					pool.capacity = std::max(chunk_size / pool.type->size, 1u);
+				}
+
+				pool.group = (tick_group::group)reader.read<u32>();
+				reader.read_items(pool.alive);
+				const u32 slot_count{ (u32)pool.alive.size() };
+				const u32 chunk_count{ (slot_count + pool.capacity - 1) / pool.capacity };
+				while (pool.chunks.size() < chunk_count)
+				{
+					pool.chunks.emplace_back(std::make_unique<u8[]>(pool.capacity * pool.type->size));
+				}
+				pool.chunks.resize(chunk_count);
+				pool.ticks.resize(slot_count);
+				pool.dts.resize(slot_count);
+
+				[[maybe_unused]] const u64 id_count{ reader.read<u64>() };
+				assert(id_count == slot_count);
+				for (u32 slot{ 0 }; slot < slot_count; ++slot)
+				{
+					game_entity::entity_id id{ id::invalid_id };
+					reader.read((u8*)&id, sizeof(id));
+					if (pool.alive[slot]) pool.type->construct(get_memory(pool, slot), game_entity::entity{ id });
+				}
+			}
+
+			// NOTE: the rest of the state is restored after all scripts are constructed, so it overwrites
+			//		 whatever their constructors did (e.g. going to sleep or changing their tick interval).
+			for (auto& pool : state.script_pools)
+			{
+				reader.read_items(pool.awake_counts);
+				reader.read_items(pool.awake);
+				reader.read_items(pool.sleep_counts);
+				reader.read_items(pool.free_slots);
+				reader.read_items(pool.intervals);
+				reader.read_items(pool.elapsed);
+				reader.read_items(pool.countdowns);
+				if (!pool.type->has_snapshot) continue;
+
+				for (u32 slot{ 0 }; slot < pool.alive.size(); ++slot)
+				{
+					if (!pool.alive[slot]) continue;
+					const u32 size{ reader.read<u32>() };
+					((entity_script*)get_memory(pool, slot))->restore(reader.position());
+					reader.skip(size);
+				}
+			}
+
+			reader.read_items(state.time_waits);
+			reader.read_items(state.frame_waits);
+			state.input_waits.clear();
+			const u32 input_wait_count{ reader.read<u32>() };
+			for (u32 i{ 0 }; i < input_wait_count; ++i)
+			{
+				const u64 binding{ reader.read<u64>() };
+				reader.read_items(state.input_waits[binding]);
+			}
+			if (!state.input_waits.empty()) listen_to_input(state);
+
+			{
+				std::lock_guard lock{ state.pending_wakes_mutex };
+				reader.read_items(state.pending_wakes);
+			}
+
+			if (state.thread_sleep_requests.empty()) state.thread_sleep_requests.resize(jobs::thread_count());
+			for (auto& requests : state.thread_sleep_requests) requests.clear();
+			reader.read_items(state.thread_sleep_requests[0]);
+
+			for (auto& cache : state.thread_caches) cache.clear();
+
+			state.current_time = reader.read<u64>();
+			state.current_frame = reader.read<u64>();
+		}
+
+		bool
+		is_updating()
+		{
+			return current().is_updating;
+		}
+
+		void
+		defer_remove(game_entity::entity_id id)
+		{
+			get_commands(current()).emplace_back(entity_command{ id });
+		}
+
+		void
+		defer_create(const game_entity::entity_info& info)
+		{
+			assert(info.transform);
+			entity_command& command{ get_commands(current()).emplace_back() };
+			command.remove_id = game_entity::entity_id{ id::invalid_id };
+			command.transform = *info.transform;
+			command.has_script = info.script && info.script->script_creator;
+			if (command.has_script) command.script = *info.script;
+		}
+
 #ifdef USE_WITH_EDITOR
 		u8
 		add_script_name(const char* name)
@@ -138,68 +860,156 @@ namespace havana::script
 	component
 	create(init_info info, game_entity::entity entity)
 	{
-		assert(entity.is_valid());
 		assert(info.script_creator);
+		assert(info.group < tick_group::count && info.tick_interval >= 0.f);
+		world_data& state{ current() };
+		// NOTE: scripts run on several threads, see game_entity::create_deferred().
+		assert(!state.is_updating);
+		return add_script(state, get_pool(state, info.script_creator, info.group), info, entity);
+	}
+
+	void
+	create_batch(const init_info& info, const game_entity::entity* const entities, u32 count, component* const components)
+	{
+		assert(info.script_creator && entities && count && components);
+		assert(info.group < tick_group::count && info.tick_interval >= 0.f);
+		world_data& state{ current() };
+		assert(!state.is_updating);
+		const u32 pool_index{ get_pool(state, info.script_creator, info.group) };
+		state.id_mapping.reserve(count);
 
-		script_id id{};
-		if (free_ids.size() > id::min_deleted_elements)
+		script_pool& pool{ state.script_pools[pool_index] };
+		const u32 free_count{ (u32)pool.free_slots.size() };
+		if (count > free_count)
 		{
-			id = free_ids.front();
-			assert(!exists(id));
-			free_ids.pop_front();
-			id = script_id{ id::new_generation(id) };
-			++generations[id::index(id)];
+			const u32 slot_count{ (u32)pool.alive.size() + count - free_count };
+			pool.alive.reserve(slot_count);
+			pool.awake.reserve(slot_count);
+			pool.sleep_counts.reserve(slot_count);
+			pool.intervals.reserve(slot_count);
+			pool.elapsed.reserve(slot_count);
+			pool.countdowns.reserve(slot_count);
+			pool.ticks.reserve(slot_count);
+			pool.dts.reserve(slot_count);
 		}
-		else
+
+		for (u32 i{ 0 }; i < count; ++i)
 		{
-			id = script_id{ (id::id_type)id_mapping.size() };
-			id_mapping.emplace_back();
-			generations.push_back(0);
+			components[i] = add_script(state, pool_index, info, entities[i]);
 		}
-
-		assert(id::is_valid(id));
-		const id::id_type index{ (id::id_type)entity_scripts.size() };
-		entity_scripts.emplace_back(info.script_creator(entity));
-		assert(entity_scripts.back()->get_id() == entity.get_id());
-		id_mapping[id::index(id)] = index;
-		return component{ id };
 	}
 
 	void
 	remove(component c)
 	{
-		assert(c.is_valid() && exists(c.get_id()));
+		world_data& state{ current() };
+		assert(!state.is_updating);
+		assert(c.is_valid() && exists(state, c.get_id()));
 		const script_id id{ c.get_id() };
-		const id::id_type index{ id_mapping[id::index(id)] };
-		const script_id last_id{ entity_scripts.back()->script().get_id() };
-		utl::erase_unordered(entity_scripts, index);
-		id_mapping[id::index(last_id)] = index;
-		id_mapping[id::index(id)] = id::invalid_id;
+		const script_location location{ state.id_mapping[id] };
+		script_pool& pool{ state.script_pools[location.pool] };
+		pool.type->destroy(get_memory(pool, location.slot));
+		pool.alive[location.slot] = 0;
+		set_awake(pool, location.slot, false);
+		++pool.sleep_counts[location.slot];
+		pool.free_slots.emplace_back(location.slot);
+		state.id_mapping.remove(id);
+	}
+
+	void
+	reserve(u32 count)
+	{
+		current().id_mapping.reserve(count);
 	}
 
 	void
 	update(float dt)
 	{
-		for (auto& ptr : entity_scripts)
+		world_data& state{ current() };
+		if (state.thread_caches.size() < jobs::thread_count())
 		{
-			ptr->update(dt);
+			state.thread_caches.resize(jobs::thread_count());
 		}
 
-		if (transform_cache.size())
+		if (state.thread_sleep_requests.size() < jobs::thread_count())
 		{
-			transform::update(transform_cache.data(), (u32)transform_cache.size());
-			transform_cache.clear();
+			state.thread_sleep_requests.resize(jobs::thread_count());
+		}
 
-#if USE_TRANSFORM_CACHE_MAP
-			cache_map.clear();
-#endif
+		if (state.thread_commands.size() < jobs::thread_count())
+		{
+			state.thread_commands.resize(jobs::thread_count());
 		}
+
+		state.current_time += (u64)(dt * 1'000'000.f);
+		++state.current_frame;
+
+		// Requests from outside of update() (e.g. from script constructors) are handled first.
+		put_scripts_to_sleep(state);
+		wake_scripts(state);
+
+		for (u32 i{ 0 }; i < tick_group::count; ++i)
+		{
+			update_group(state, (tick_group::group)i, dt);
+		}
+	}
+
+	void
+	wake(component c)
+	{
+		assert(c.is_valid());
+		world_data& state{ current() };
+		std::lock_guard lock{ state.pending_wakes_mutex };
+		state.pending_wakes.emplace_back(script_wait{ 0, c.get_id(), u32_invalid_id });
+	}
+
+	void
+	entity_script::sleep() const
+	{
+		request_sleep(current(), this, wait_type::event, 0, 0);
+	}
+
+	void
+	entity_script::sleep_for(f32 seconds) const
+	{
+		assert(seconds >= 0.f);
+		world_data& state{ current() };
+		request_sleep(state, this, wait_type::time, state.current_time + (u64)(seconds * 1'000'000.f), 0);
+	}
+
+	void
+	entity_script::sleep_for_frames(u32 frames) const
+	{
+		world_data& state{ current() };
+		// NOTE: wake_scripts() runs after current_frame is incremented for the next update. Without the +1,
+		//		 sleep_for_frames(1) would wake the script in time for that update and skip nothing.
+		request_sleep(state, this, wait_type::frames, state.current_frame + frames + 1, 0);
+	}
+
+	void
+	entity_script::sleep_until_input(u64 binding) const
+	{
+		request_sleep(current(), this, wait_type::input, 0, binding);
+	}
+
+	void
+	entity_script::set_tick_interval(f32 interval) const
+	{
+		assert(interval >= 0.f);
+		world_data& state{ current() };
+		const script_id id{ script().get_id() };
+		assert(exists(state, id));
+		const script_location location{ state.id_mapping[id] };
+		script_pool& pool{ state.script_pools[location.pool] };
+		// The new interval applies to the current wait too.
+		pool.countdowns[location.slot] += interval - pool.intervals[location.slot];
+		pool.intervals[location.slot] = interval;
 	}
 
 	void
 	entity_script::set_rotation(const game_entity::entity* const entity, math::v4 rotation_quaternion)
 	{
-		transform::component_cache& cache{ *get_cache_ptr(entity) };
+		transform::component_cache& cache{ *get_cache_ptr(current(), entity) };
 		cache.flags |= transform::component_flags::rotation;
 		cache.rotation = rotation_quaternion;
 	}
@@ -207,7 +1017,7 @@ namespace havana::script
 	void
 	entity_script::set_orientation(const game_entity::entity* const entity, math::v3 orientation_vector)
 	{
-		transform::component_cache& cache{ *get_cache_ptr(entity) };
+		transform::component_cache& cache{ *get_cache_ptr(current(), entity) };
 		cache.flags |= transform::component_flags::orientation;
 		cache.orientation = orientation_vector;
 	}
@@ -215,7 +1025,7 @@ namespace havana::script
 	void
 	entity_script::set_position(const game_entity::entity* const entity, math::v3 position)
 	{
-		transform::component_cache& cache{ *get_cache_ptr(entity) };
+		transform::component_cache& cache{ *get_cache_ptr(current(), entity) };
 		cache.flags |= transform::component_flags::position;
 		cache.position = position;
 	}
@@ -223,7 +1033,7 @@ namespace havana::script
 	void
 	entity_script::set_scale(const game_entity::entity* const entity, math::v3 scale)
 	{
-		transform::component_cache& cache{ *get_cache_ptr(entity) };
+		transform::component_cache& cache{ *get_cache_ptr(current(), entity) };
 		cache.flags |= transform::component_flags::scale;
 		cache.scale = scale;
 	}
@@ -1,14 +1,63 @@
 #pragma once
 #include "ComponentsCommon.h"
 
+namespace havana::game_entity { struct entity_info; }
+
 namespace havana::script
 {
+	// Scripts in a tick group are all updated before the scripts of the next group.
+	// Transform changes of a group are applied before the next group runs, so
+	// post_transform scripts see the world matrices of the current frame.
+	struct tick_group
+	{
+		enum group : u32
+		{
+			pre_transform,
+			post_transform,
+
+			count
+		};
+	};
+
 	struct init_info
 	{
 		detail::script_creator script_creator;
+		tick_group::group group{ tick_group::pre_transform };
+		// Minimum time in seconds between two updates of the script. Scripts that don't need
+		// to run every frame (e.g. far away or low priority ones) can use this to stay cheap.
+		// The script gets the time since its last update as 'dt'. 0 means every frame.
+		f32 tick_interval{ 0.f };
 	};
 
 	component create(init_info info, game_entity::entity entity);
+	// Creates one script of the same class for each entity. The script pool is looked up once for the whole batch.
+	void create_batch(const init_info& info, const game_entity::entity* const entities, u32 count, component* const components);
 	void remove(component c);
+	// Makes sure there is room for 'count' more scripts without reallocating.
+	void reserve(u32 count);
 	void update(float dt);
+	// Wakes up a sleeping script before its next update. Can be called from any thread.
+	void wake(component c);
+
+	namespace detail
+	{
+		// Script storage of one world. See World.h.
+		struct world_data;
+		world_data* create_world();
+		void remove_world(world_data* const data);
+		void set_current_world(world_data* const data);
+
+		// World snapshots. See world::save_snapshot(). Scripts are destroyed with destroy_scripts()
+		// before the other systems of the world are restored, and constructed again by restore_world().
+		void destroy_scripts(world_data* const data);
+		u64 snapshot_size(const world_data* const data);
+		void save_world(const world_data* const data, utl::blob_stream_writer& writer);
+		void restore_world(world_data* const data, utl::blob_stream_reader& reader);
+
+		// True while scripts of the current world are updated on several threads. Entities that are
+		// created or removed in the meantime are queued and applied after the update of the tick group.
+		bool is_updating();
+		void defer_remove(game_entity::entity_id id);
+		void defer_create(const game_entity::entity_info& info);
+	}
 }
\ No newline at end of file
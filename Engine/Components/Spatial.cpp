@@ -0,0 +1,934 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "Spatial.h"
+#include "Entity.h"
+#include "Transform.h"
+#include "World.h"
+
+namespace havana::spatial
+{
+	namespace // anonymous namespace
+	{
+		constexpr f32 cell_size{ 16.f };
+		constexpr f32 inv_cell_size{ 1.f / cell_size };
+		constexpr u32 max_leaf_size{ 8 };
+		constexpr u32 max_bvh_depth{ 64 };
+
+		// An entity as it's stored in the grid and in the static hierarchy.
+		struct entry
+		{
+			math::v3				center;
+			f32						radius;
+			game_entity::entity_id	id;
+		};
+
+		// NOTE: entities are stored in the cell that contains their center. A query has to look at the
+		//		 neighbouring cells as well, as far as the largest radius of any entity in the grid.
+		struct grid_cell
+		{
+			s32						x, y, z;
+			utl::vector<entry>		entries;
+		};
+
+		struct aabb
+		{
+			math::v3				min;
+			math::v3				max;
+		};
+
+		// Nodes are stored in depth-first order, so the first child of an inner node always follows it.
+		// 'first' is the index of the second child for inner nodes and of the first entry for leaves.
+		struct bvh_node
+		{
+			aabb					bounds;
+			u32						first;
+			u32						count;	// 0 for inner nodes
+		};
+
+		// Where an entity is stored, indexed by entity index. 'slot' is the index in the entries of
+		// its cell (or in the static entries) and u32_invalid_id until the entity is added.
+		struct location
+		{
+			game_entity::entity_id	id{ id::invalid_id };
+			f32						radius{ 0.f };
+			u32						cell{ u32_invalid_id };
+			u32						slot{ u32_invalid_id };
+			bool					is_static{ false };
+		};
+	} // anonymous namespace
+
+	namespace detail
+	{
+		struct world_data
+		{
+			utl::vector<location>				locations;
+			std::unordered_map<u64, u32>		cell_map;
+			utl::vector<grid_cell>				cells;
+			// NOTE: this never shrinks. A very large entity makes every grid query look at more cells.
+			f32									max_radius{ 0.f };
+
+			utl::vector<entry>					static_entries;
+			utl::vector<bvh_node>				bvh;
+			bool								is_bvh_dirty{ false };
+
+			utl::vector<game_entity::entity_id>	changed_ids;
+			utl::vector<math::v3>				changed_positions;
+		};
+	} // detail namespace
+
+	namespace // anonymous namespace
+	{
+		using detail::world_data;
+
+		// NOTE: null until the thread first uses the spatial index or makes a world current.
+		thread_local world_data*				current_world{ nullptr };
+
+		world_data&
+		current()
+		{
+			if (!current_world) world::set_current(world::default_world());
+			return *current_world;
+		}
+
+		s32
+		cell_coordinate(f32 value)
+		{
+			return (s32)std::floor(value * inv_cell_size);
+		}
+
+		u64
+		cell_key(s32 x, s32 y, s32 z)
+		{
+			// NOTE: 21 bits per axis cover more than a million cells in each direction.
+			constexpr u64 mask{ (u64{ 1 } << 21) - 1 };
+			return ((u64)(u32)x & mask) | (((u64)(u32)y & mask) << 21) | (((u64)(u32)z & mask) << 42);
+		}
+
+		aabb
+		cell_bounds(const grid_cell& cell, f32 margin)
+		{
+			const math::v3 min{ cell.x * cell_size - margin, cell.y * cell_size - margin, cell.z * cell_size - margin };
+			return aabb{ min, math::v3{ min.x + cell_size + 2.f * margin, min.y + cell_size + 2.f * margin, min.z + cell_size + 2.f * margin } };
+		}
+
+		f32
+		dot(const math::v3& a, const math::v3& b)
+		{
+			return a.x * b.x + a.y * b.y + a.z * b.z;
+		}
+
+		math::v3
+		subtract(const math::v3& a, const math::v3& b)
+		{
+			return math::v3{ a.x - b.x, a.y - b.y, a.z - b.z };
+		}
+
+		math::v3
+		cross(const math::v3& a, const math::v3& b)
+		{
+			return math::v3{ a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+		}
+
+		// Finds the box around a frustum from the points where three of its planes meet. The planes are moved
+		// out by 'margin' first. Returns false if they don't enclose a finite volume, e.g. without a far plane.
+		bool
+		frustum_bounds(const frustum& f, f32 margin, aabb& bounds)
+		{
+			math::v3 normals[6];
+			for (u32 i{ 0 }; i < 6; ++i) normals[i] = math::v3{ f.planes[i].x, f.planes[i].y, f.planes[i].z };
+
+			// The volume is infinite if some direction points into all planes. If there is one, there's
+			// also one along an edge where two planes meet.
+			for (u32 i{ 0 }; i < 6; ++i)
+			{
+				for (u32 j{ i + 1 }; j < 6; ++j)
+				{
+					const math::v3 edge{ cross(normals[i], normals[j]) };
+					if (dot(edge, edge) < math::epsilon) continue;
+
+					bool is_inside{ true }, is_outside{ true };
+					for (u32 k{ 0 }; k < 6; ++k)
+					{
+						const f32 d{ dot(normals[k], edge) };
+						is_inside = is_inside && d > -math::epsilon;
+						is_outside = is_outside && d < math::epsilon;
+					}
+					if (is_inside || is_outside) return false;
+				}
+			}
+
+			bounds = aabb{ math::v3{ std::numeric_limits<f32>::max(), std::numeric_limits<f32>::max(), std::numeric_limits<f32>::max() },
+						   math::v3{ -std::numeric_limits<f32>::max(), -std::numeric_limits<f32>::max(), -std::numeric_limits<f32>::max() } };
+			u32 corner_count{ 0 };
+			for (u32 i{ 0 }; i < 6; ++i)
+			{
+				for (u32 j{ i + 1 }; j < 6; ++j)
+				{
+					for (u32 k{ j + 1 }; k < 6; ++k)
+					{
+						const math::v3 jk{ cross(normals[j], normals[k]) };
+						const f32 det{ dot(normals[i], jk) };
+						if (std::abs(det) < math::epsilon) continue;
+
+						const math::v3 ki{ cross(normals[k], normals[i]) };
+						const math::v3 ij{ cross(normals[i], normals[j]) };
+						const f32 di{ f.planes[i].w + margin }, dj{ f.planes[j].w + margin }, dk{ f.planes[k].w + margin };
+						const f32 scale{ -1.f / det };
+						const math::v3 p{ (di * jk.x + dj * ki.x + dk * ij.x) * scale,
+										  (di * jk.y + dj * ki.y + dk * ij.y) * scale,
+										  (di * jk.z + dj * ki.z + dk * ij.z) * scale };
+
+						// Only the points that are on the frustum are corners.
+						const f32 tolerance{ 1e-3f * (1.f + std::abs(p.x) + std::abs(p.y) + std::abs(p.z)) };
+						bool is_corner{ true };
+						for (u32 m{ 0 }; m < 6 && is_corner; ++m)
+						{
+							is_corner = dot(normals[m], p) + f.planes[m].w + margin >= -tolerance;
+						}
+						if (!is_corner) continue;
+
+						bounds.min = math::v3{ std::min(bounds.min.x, p.x), std::min(bounds.min.y, p.y), std::min(bounds.min.z, p.z) };
+						bounds.max = math::v3{ std::max(bounds.max.x, p.x), std::max(bounds.max.y, p.y), std::max(bounds.max.z, p.z) };
+						++corner_count;
+					}
+				}
+			}
+
+			return corner_count >= 4;
+		}
+
+		bool
+		intersects(const aabb& box, const sphere& s)
+		{
+			f32 distance_squared{ 0.f };
+			const f32* const c{ &s.center.x };
+			const f32* const min{ &box.min.x };
+			const f32* const max{ &box.max.x };
+			for (u32 i{ 0 }; i < 3; ++i)
+			{
+				const f32 d{ c[i] < min[i] ? min[i] - c[i] : c[i] > max[i] ? c[i] - max[i] : 0.f };
+				distance_squared += d * d;
+			}
+			return distance_squared <= s.radius * s.radius;
+		}
+
+		bool
+		intersects(const entry& e, const sphere& s)
+		{
+			const math::v3 d{ subtract(e.center, s.center) };
+			const f32 r{ e.radius + s.radius };
+			return dot(d, d) <= r * r;
+		}
+
+		bool
+		intersects(const aabb& box, const frustum& f)
+		{
+			for (const math::v4& plane : f.planes)
+			{
+				// The corner that is furthest along the plane normal is enough to know if the box is outside.
+				const math::v3 corner{ plane.x >= 0.f ? box.max.x : box.min.x, plane.y >= 0.f ? box.max.y : box.min.y, plane.z >= 0.f ? box.max.z : box.min.z };
+				if (plane.x * corner.x + plane.y * corner.y + plane.z * corner.z + plane.w < 0.f) return false;
+			}
+			return true;
+		}
+
+		bool
+		intersects(const entry& e, const frustum& f)
+		{
+			for (const math::v4& plane : f.planes)
+			{
+				if (plane.x * e.center.x + plane.y * e.center.y + plane.z * e.center.z + plane.w < -e.radius) return false;
+			}
+			return true;
+		}
+
+		bool
+		intersects(const aabb& box, const ray& r)
+		{
+			// Slab test against the segment [origin, origin + direction * length].
+			f32 t_min{ 0.f };
+			f32 t_max{ r.length };
+			const f32* const origin{ &r.origin.x };
+			const f32* const direction{ &r.direction.x };
+			const f32* const min{ &box.min.x };
+			const f32* const max{ &box.max.x };
+			for (u32 i{ 0 }; i < 3; ++i)
+			{
+				if (std::abs(direction[i]) < math::epsilon)
+				{
+					if (origin[i] < min[i] || origin[i] > max[i]) return false;
+					continue;
+				}
+
+				const f32 inv_d{ 1.f / direction[i] };
+				f32 t0{ (min[i] - origin[i]) * inv_d };
+				f32 t1{ (max[i] - origin[i]) * inv_d };
+				if (t0 > t1) std::swap(t0, t1);
+				t_min = std::max(t_min, t0);
+				t_max = std::min(t_max, t1);
+				if (t_min > t_max) return false;
+			}
+			return true;
+		}
+
+		// Returns the distance along the ray to the first point of the sphere, or a negative value for a miss.
+		f32
+		hit_distance(const entry& e, const ray& r)
+		{
+			const math::v3 to_center{ subtract(e.center, r.origin) };
+			const f32 t{ dot(to_center, r.direction) };
+			const f32 distance_squared{ dot(to_center, to_center) };
+			const f32 radius_squared{ e.radius * e.radius };
+			if (distance_squared <= radius_squared) return 0.f; // the ray starts inside
+
+			const f32 d2{ distance_squared - t * t };
+			if (t < 0.f || d2 > radius_squared) return -1.f;
+			const f32 hit{ t - std::sqrt(radius_squared - d2) };
+			return hit <= r.length ? hit : -1.f;
+		}
+
+		bool
+		intersects(const entry& e, const ray& r)
+		{
+			return hit_distance(e, r) >= 0.f;
+		}
+
+		// Calls 'func(entry)' for every entry in the grid that intersects 'query'.
+		template<typename Q, typename F>
+		void
+		visit_cells(const world_data& state, const Q& query, const F& func)
+		{
+			for (const grid_cell& cell : state.cells)
+			{
+				if (!intersects(cell_bounds(cell, state.max_radius), query)) continue;
+				for (const entry& e : cell.entries)
+				{
+					if (intersects(e, query)) func(e);
+				}
+			}
+		}
+
+		// NOTE: small spheres only touch a few cells. Looking those up is faster than testing every cell.
+		template<typename F>
+		void
+		visit_cells(const world_data& state, const sphere& query, const F& func)
+		{
+			const f32 reach{ query.radius + state.max_radius };
+			const s32 min_x{ cell_coordinate(query.center.x - reach) }, max_x{ cell_coordinate(query.center.x + reach) };
+			const s32 min_y{ cell_coordinate(query.center.y - reach) }, max_y{ cell_coordinate(query.center.y + reach) };
+			const s32 min_z{ cell_coordinate(query.center.z - reach) }, max_z{ cell_coordinate(query.center.z + reach) };
+			const u64 cell_count{ (u64)(max_x - min_x + 1) * (u64)(max_y - min_y + 1) * (u64)(max_z - min_z + 1) };
+
+			if (cell_count > state.cells.size())
+			{
+				visit_cells<sphere, F>(state, query, func);
+				return;
+			}
+
+			for (s32 z{ min_z }; z <= max_z; ++z)
+			{
+				for (s32 y{ min_y }; y <= max_y; ++y)
+				{
+					for (s32 x{ min_x }; x <= max_x; ++x)
+					{
+						const auto cell{ state.cell_map.find(cell_key(x, y, z)) };
+						if (cell == state.cell_map.end()) continue;
+						for (const entry& e : state.cells[cell->second].entries)
+						{
+							if (intersects(e, query)) func(e);
+						}
+					}
+				}
+			}
+		}
+
+		// NOTE: a frustum usually covers a small part of the world. If there are fewer cells in the box around
+		//		 it than in the grid, those are looked up instead of testing every cell.
+		template<typename F>
+		void
+		visit_cells(const world_data& state, const frustum& query, const F& func)
+		{
+			// NOTE: entities are tested against each plane on its own, so the planes are moved out by the largest
+			//		 radius. Growing the box around the frustum isn't enough near its corners.
+			aabb bounds;
+			if (!frustum_bounds(query, state.max_radius, bounds))
+			{
+				visit_cells<frustum, F>(state, query, func);
+				return;
+			}
+
+			const s32 min_x{ cell_coordinate(bounds.min.x) }, max_x{ cell_coordinate(bounds.max.x) };
+			const s32 min_y{ cell_coordinate(bounds.min.y) }, max_y{ cell_coordinate(bounds.max.y) };
+			const s32 min_z{ cell_coordinate(bounds.min.z) }, max_z{ cell_coordinate(bounds.max.z) };
+			const u64 cell_count{ (u64)(max_x - min_x + 1) * (u64)(max_y - min_y + 1) * (u64)(max_z - min_z + 1) };
+
+			if (cell_count > state.cells.size())
+			{
+				visit_cells<frustum, F>(state, query, func);
+				return;
+			}
+
+			for (s32 z{ min_z }; z <= max_z; ++z)
+			{
+				for (s32 y{ min_y }; y <= max_y; ++y)
+				{
+					for (s32 x{ min_x }; x <= max_x; ++x)
+					{
+						const auto cell{ state.cell_map.find(cell_key(x, y, z)) };
+						if (cell == state.cell_map.end()) continue;
+						const grid_cell& c{ state.cells[cell->second] };
+						if (!intersects(cell_bounds(c, state.max_radius), query)) continue;
+						for (const entry& e : c.entries)
+						{
+							if (intersects(e, query)) func(e);
+						}
+					}
+				}
+			}
+		}
+
+		// NOTE: a ray only passes through a few cells. They're walked in the order the ray crosses them (3D DDA),
+		//		 together with the neighbours that are close enough for their entities to reach the ray.
+		template<typename F>
+		void
+		visit_cells(const world_data& state, const ray& query, const F& func)
+		{
+			const f32* const origin{ &query.origin.x };
+			const f32* const direction{ &query.direction.x };
+			const s32 margin{ (s32)std::ceil(state.max_radius * inv_cell_size) };
+			const u64 width{ (u64)(2 * margin + 1) };
+
+			s32 cell[3];
+			s32 step[3];
+			f32 t_next[3];
+			f32 t_delta[3];
+			u64 crossings{ 0 };
+			for (u32 i{ 0 }; i < 3; ++i)
+			{
+				cell[i] = cell_coordinate(origin[i]);
+				crossings += (u64)std::abs(cell_coordinate(origin[i] + direction[i] * query.length) - cell[i]);
+				if (direction[i] == 0.f)
+				{
+					step[i] = 0;
+					t_next[i] = t_delta[i] = std::numeric_limits<f32>::max();
+					continue;
+				}
+
+				step[i] = direction[i] > 0.f ? 1 : -1;
+				t_next[i] = ((cell[i] + (step[i] > 0 ? 1 : 0)) * cell_size - origin[i]) / direction[i];
+				t_delta[i] = cell_size / std::abs(direction[i]);
+			}
+
+			// The first cell brings its whole neighbourhood and every step one layer of it.
+			if (width * width * (width + crossings) > state.cells.size())
+			{
+				visit_cells<ray, F>(state, query, func);
+				return;
+			}
+
+			const auto visit_block = [&state, &query, &func](const s32 (&min)[3], const s32 (&max)[3])
+			{
+				for (s32 z{ min[2] }; z <= max[2]; ++z)
+				{
+					for (s32 y{ min[1] }; y <= max[1]; ++y)
+					{
+						for (s32 x{ min[0] }; x <= max[0]; ++x)
+						{
+							const auto c{ state.cell_map.find(cell_key(x, y, z)) };
+							if (c == state.cell_map.end()) continue;
+							for (const entry& e : state.cells[c->second].entries)
+							{
+								if (intersects(e, query)) func(e);
+							}
+						}
+					}
+				}
+			};
+
+			s32 min[3]{ cell[0] - margin, cell[1] - margin, cell[2] - margin };
+			s32 max[3]{ cell[0] + margin, cell[1] + margin, cell[2] + margin };
+			visit_block(min, max);
+
+			while (true)
+			{
+				const u32 axis{ t_next[0] < t_next[1] ? (t_next[0] < t_next[2] ? 0u : 2u) : (t_next[1] < t_next[2] ? 1u : 2u) };
+				if (t_next[axis] > query.length) break;
+				cell[axis] += step[axis];
+				t_next[axis] += t_delta[axis];
+
+				// The ray moves along one axis at a time and never back, so the only neighbours we haven't
+				// visited yet are the layer on the side it moved to.
+				for (u32 i{ 0 }; i < 3; ++i)
+				{
+					min[i] = cell[i] - margin;
+					max[i] = cell[i] + margin;
+				}
+				min[axis] = max[axis] = cell[axis] + step[axis] * margin;
+				visit_block(min, max);
+			}
+		}
+
+		// Calls 'func(entry)' for every static entry that intersects 'query'.
+		template<typename Q, typename F>
+		void
+		visit_bvh(const world_data& state, const Q& query, const F& func)
+		{
+			if (state.bvh.empty()) return;
+
+			u32 stack[max_bvh_depth];
+			u32 stack_size{ 0 };
+			stack[stack_size++] = 0;
+			while (stack_size)
+			{
+				const u32 index{ stack[--stack_size] };
+				const bvh_node& node{ state.bvh[index] };
+				if (!intersects(node.bounds, query)) continue;
+
+				if (node.count)
+				{
+					for (u32 i{ node.first }; i < node.first + node.count; ++i)
+					{
+						const entry& e{ state.static_entries[i] };
+						if (intersects(e, query)) func(e);
+					}
+				}
+				else
+				{
+					assert(stack_size + 2 <= max_bvh_depth);
+					stack[stack_size++] = node.first;
+					stack[stack_size++] = index + 1;
+				}
+			}
+		}
+
+		template<typename Q, typename F>
+		void
+		visit(const world_data& state, const Q& query, const F& func)
+		{
+			visit_cells(state, query, func);
+			visit_bvh(state, query, func);
+		}
+
+		location&
+		get_location(world_data& state, game_entity::entity_id id)
+		{
+			const u32 index{ id::index(id) };
+			if (index >= state.locations.size())
+			{
+				state.locations.resize(index + 1);
+			}
+
+			location& loc{ state.locations[index] };
+			if (loc.id != id)
+			{
+				// NOTE: a removed entity is taken out of the index, so this slot is either unused or stale.
+				assert(loc.slot == u32_invalid_id || !game_entity::is_alive(loc.id));
+				loc = location{ id };
+			}
+			return loc;
+		}
+
+		void
+		add_entry(world_data& state, location& loc, const math::v3& center)
+		{
+			const entry e{ center, loc.radius, loc.id };
+			if (loc.is_static)
+			{
+				loc.cell = u32_invalid_id;
+				loc.slot = (u32)state.static_entries.size();
+				state.static_entries.emplace_back(e);
+				state.is_bvh_dirty = true;
+				return;
+			}
+
+			const s32 x{ cell_coordinate(center.x) };
+			const s32 y{ cell_coordinate(center.y) };
+			const s32 z{ cell_coordinate(center.z) };
+			const u64 key{ cell_key(x, y, z) };
+			auto cell{ state.cell_map.find(key) };
+			if (cell == state.cell_map.end())
+			{
+				cell = state.cell_map.emplace(key, (u32)state.cells.size()).first;
+				grid_cell& new_cell{ state.cells.emplace_back() };
+				new_cell.x = x;
+				new_cell.y = y;
+				new_cell.z = z;
+			}
+
+			utl::vector<entry>& entries{ state.cells[cell->second].entries };
+			loc.cell = cell->second;
+			loc.slot = (u32)entries.size();
+			entries.emplace_back(e);
+			state.max_radius = std::max(state.max_radius, loc.radius);
+		}
+
+		void
+		remove_entry(world_data& state, location& loc)
+		{
+			assert(loc.slot != u32_invalid_id);
+			if (loc.is_static)
+			{
+				state.static_entries.erase_unordered(state.static_entries.begin() + loc.slot);
+				if (loc.slot < state.static_entries.size())
+				{
+					state.locations[id::index(state.static_entries[loc.slot].id)].slot = loc.slot;
+				}
+				state.is_bvh_dirty = true;
+				loc.slot = u32_invalid_id;
+				return;
+			}
+
+			utl::vector<entry>& entries{ state.cells[loc.cell].entries };
+			entries.erase_unordered(entries.begin() + loc.slot);
+			if (loc.slot < entries.size())
+			{
+				state.locations[id::index(entries[loc.slot].id)].slot = loc.slot;
+			}
+
+			if (entries.empty())
+			{
+				// Move the last cell into the hole to keep the cells dense.
+				const u32 cell_index{ loc.cell };
+				const grid_cell& cell{ state.cells[cell_index] };
+				state.cell_map.erase(cell_key(cell.x, cell.y, cell.z));
+
+				const u32 last{ (u32)state.cells.size() - 1 };
+				if (cell_index != last)
+				{
+					std::swap(state.cells[cell_index], state.cells[last]);
+					const grid_cell& moved{ state.cells[cell_index] };
+					state.cell_map[cell_key(moved.x, moved.y, moved.z)] = cell_index;
+					for (const entry& e : moved.entries)
+					{
+						state.locations[id::index(e.id)].cell = cell_index;
+					}
+				}
+				state.cells.resize(last);
+			}
+
+			loc.cell = u32_invalid_id;
+			loc.slot = u32_invalid_id;
+		}
+
+		aabb
+		bounds_of(const entry& e)
+		{
+			return aabb{ math::v3{ e.center.x - e.radius, e.center.y - e.radius, e.center.z - e.radius },
+						 math::v3{ e.center.x + e.radius, e.center.y + e.radius, e.center.z + e.radius } };
+		}
+
+		void
+		merge(aabb& box, const aabb& other)
+		{
+			box.min = math::v3{ std::min(box.min.x, other.min.x), std::min(box.min.y, other.min.y), std::min(box.min.z, other.min.z) };
+			box.max = math::v3{ std::max(box.max.x, other.max.x), std::max(box.max.y, other.max.y), std::max(box.max.z, other.max.z) };
+		}
+
+		// Builds the subtree over static_entries[first, first + count) and returns the index of its root.
+		u32
+		build_node(world_data& state, u32 first, u32 count, u32 depth)
+		{
+			const u32 index{ (u32)state.bvh.size() };
+			state.bvh.emplace_back();
+
+			aabb bounds{ bounds_of(state.static_entries[first]) };
+			aabb centers{ state.static_entries[first].center, state.static_entries[first].center };
+			for (u32 i{ first + 1 }; i < first + count; ++i)
+			{
+				const entry& e{ state.static_entries[i] };
+				merge(bounds, bounds_of(e));
+				merge(centers, aabb{ e.center, e.center });
+			}
+			state.bvh[index].bounds = bounds;
+
+			// NOTE: the traversal stack holds at most two nodes per level.
+			if (count <= max_leaf_size || depth + 1 >= max_bvh_depth / 2)
+			{
+				state.bvh[index].first = first;
+				state.bvh[index].count = count;
+				return index;
+			}
+
+			// Split at the median of the axis along which the centers are spread the most.
+			const math::v3 extent{ subtract(centers.max, centers.min) };
+			const u32 axis{ extent.x >= extent.y && extent.x >= extent.z ? 0u : extent.y >= extent.z ? 1u : 2u };
+			const u32 middle{ first + count / 2 };
+			entry* const entries{ state.static_entries.data() };
+			std::nth_element(entries + first, entries + middle, entries + first + count, [axis](const entry& a, const entry& b)
+			{
+				return (&a.center.x)[axis] < (&b.center.x)[axis];
+			});
+
+			build_node(state, first, middle - first, depth + 1);
+			const u32 second{ build_node(state, middle, first + count - middle, depth + 1) };
+			state.bvh[index].first = second;
+			state.bvh[index].count = 0;
+			return index;
+		}
+
+		void
+		build_bvh(world_data& state)
+		{
+			state.bvh.clear();
+			state.is_bvh_dirty = false;
+			const u32 count{ (u32)state.static_entries.size() };
+			if (!count) return;
+
+			state.bvh.reserve(2 * (count / max_leaf_size + 1));
+			build_node(state, 0, count, 0);
+
+			// The build reorders the entries, so their locations have to be updated.
+			for (u32 i{ 0 }; i < count; ++i)
+			{
+				state.locations[id::index(state.static_entries[i].id)].slot = i;
+			}
+		}
+
+		template<typename Q>
+		void
+		run_queries(const Q* const queries, u32 count, query_results& results)
+		{
+			assert(queries && count);
+			const world_data& state{ current() };
+			results.ids.clear();
+			results.offsets.clear();
+			results.offsets.emplace_back(0);
+
+			for (u32 i{ 0 }; i < count; ++i)
+			{
+				visit(state, queries[i], [&results](const entry& e) { results.ids.emplace_back(e.id); });
+				results.offsets.emplace_back((u32)results.ids.size());
+			}
+		}
+	} // anonymous namespace
+
+	namespace detail
+	{
+		world_data*
+		create_world()
+		{
+			return new world_data{};
+		}
+
+		void
+		remove_world(world_data* const data)
+		{
+			assert(data);
+			delete data;
+		}
+
+		void
+		set_current_world(world_data* const data)
+		{
+			current_world = data;
+		}
+
+		u64
+		snapshot_size(const world_data* const data)
+		{
+			assert(data);
+			using writer = utl::blob_stream_writer;
+			u64 size{ writer::items_size(data->locations) + sizeof(u32) };
+			for (const auto& cell : data->cells)
+			{
+				size += sizeof(cell.x) + sizeof(cell.y) + sizeof(cell.z) + writer::items_size(cell.entries);
+			}
+			size += sizeof(data->max_radius) + writer::items_size(data->static_entries);
+			size += writer::items_size(data->bvh) + sizeof(data->is_bvh_dirty);
+			return size;
+		}
+
+		void
+		save_world(const world_data* const data, utl::blob_stream_writer& writer)
+		{
+			assert(data);
+			writer.write_items(data->locations);
+			writer.write((u32)data->cells.size());
+			for (const auto& cell : data->cells)
+			{
+				writer.write(cell.x);
+				writer.write(cell.y);
+				writer.write(cell.z);
+				writer.write_items(cell.entries);
+			}
+			writer.write(data->max_radius);
+			writer.write_items(data->static_entries);
+			writer.write_items(data->bvh);
+			writer.write(data->is_bvh_dirty);
+		}
+
+		void
+		restore_world(world_data* const data, utl::blob_stream_reader& reader)
+		{
+			assert(data);
+			reader.read_items(data->locations);
+			data->cells.resize(reader.read<u32>());
+			data->cell_map.clear();
+			for (u32 i{ 0 }; i < data->cells.size(); ++i)
+			{
+				grid_cell& cell{ data->cells[i] };
+				cell.x = reader.read<s32>();
+				cell.y = reader.read<s32>();
+				cell.z = reader.read<s32>();
+				reader.read_items(cell.entries);
+				data->cell_map[cell_key(cell.x, cell.y, cell.z)] = i;
+			}
+			data->max_radius = reader.read<f32>();
+			reader.read_items(data->static_entries);
+			reader.read_items(data->bvh);
+			data->is_bvh_dirty = reader.read<bool>();
+		}
+	} // detail namespace
+
+	void
+	set_radius(game_entity::entity_id id, f32 radius)
+	{
+		assert(game_entity::is_alive(id) && radius >= 0.f);
+		world_data& state{ current() };
+		location& loc{ get_location(state, id) };
+		loc.radius = radius;
+		if (loc.slot == u32_invalid_id) return;
+
+		if (loc.is_static)
+		{
+			state.static_entries[loc.slot].radius = radius;
+			state.is_bvh_dirty = true;
+		}
+		else
+		{
+			state.cells[loc.cell].entries[loc.slot].radius = radius;
+			state.max_radius = std::max(state.max_radius, radius);
+		}
+	}
+
+	void
+	set_static(game_entity::entity_id id, bool is_static)
+	{
+		assert(game_entity::is_alive(id));
+		world_data& state{ current() };
+		location& loc{ get_location(state, id) };
+		if (loc.is_static == is_static) return;
+
+		if (loc.slot == u32_invalid_id)
+		{
+			loc.is_static = is_static;
+			return;
+		}
+
+		const math::v3 center{ loc.is_static ? state.static_entries[loc.slot].center : state.cells[loc.cell].entries[loc.slot].center };
+		remove_entry(state, loc);
+		loc.is_static = is_static;
+		add_entry(state, loc, center);
+	}
+
+	void
+	remove(game_entity::entity_id id)
+	{
+		world_data& state{ current() };
+		const u32 index{ id::index(id) };
+		if (index >= state.locations.size() || state.locations[index].id != id) return;
+
+		location& loc{ state.locations[index] };
+		if (loc.slot != u32_invalid_id) remove_entry(state, loc);
+		loc = location{};
+	}
+
+	void
+	update()
+	{
+		world_data& state{ current() };
+		utl::vector<game_entity::entity_id>& ids{ state.changed_ids };
+		transform::get_frame_changes(ids);
+
+		// Entities that were removed after their transform changed are already out of the index.
+		u32 count{ 0 };
+		for (const game_entity::entity_id id : ids)
+		{
+			if (game_entity::is_alive(id)) ids[count++] = id;
+		}
+		ids.resize(count);
+
+		if (count)
+		{
+			state.changed_positions.resize(count);
+			transform::get_world_positions(ids.data(), count, state.changed_positions.data());
+		}
+
+		for (u32 i{ 0 }; i < count; ++i)
+		{
+			location& loc{ get_location(state, ids[i]) };
+			const math::v3& center{ state.changed_positions[i] };
+			if (loc.slot == u32_invalid_id)
+			{
+				add_entry(state, loc, center);
+			}
+			else if (loc.is_static)
+			{
+				state.static_entries[loc.slot].center = center;
+				state.is_bvh_dirty = true;
+			}
+			else
+			{
+				const grid_cell& cell{ state.cells[loc.cell] };
+				if (cell.x == cell_coordinate(center.x) && cell.y == cell_coordinate(center.y) && cell.z == cell_coordinate(center.z))
+				{
+					state.cells[loc.cell].entries[loc.slot].center = center;
+				}
+				else
+				{
+					remove_entry(state, loc);
+					add_entry(state, loc, center);
+				}
+			}
+		}
+
+		if (state.is_bvh_dirty)
+		{
+			build_bvh(state);
+		}
+	}
+
+	void
+	query(const sphere* const spheres, u32 count, query_results& results)
+	{
+		run_queries(spheres, count, results);
+	}
+
+	void
+	query(const frustum* const frustums, u32 count, query_results& results)
+	{
+		run_queries(frustums, count, results);
+	}
+
+	void
+	query(const ray* const rays, u32 count, query_results& results)
+	{
+		assert(rays && count);
+		const world_data& state{ current() };
+		results.ids.clear();
+		results.offsets.clear();
+		results.offsets.emplace_back(0);
+
+		struct hit
+		{
+			f32						distance;
+			game_entity::entity_id	id;
+		};
+		utl::vector<hit> hits;
+
+		for (u32 i{ 0 }; i < count; ++i)
+		{
+			const ray& r{ rays[i] };
+			hits.clear();
+			visit(state, r, [&hits, &r](const entry& e) { hits.emplace_back(hit{ hit_distance(e, r), e.id }); });
+			std::sort(hits.begin(), hits.end(), [](const hit& a, const hit& b) { return a.distance < b.distance; });
+
+			for (const hit& h : hits)
+			{
+				results.ids.emplace_back(h.id);
+			}
+			results.offsets.emplace_back((u32)results.ids.size());
+		}
+	}
+}
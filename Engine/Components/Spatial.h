@@ -0,0 +1,70 @@
+#pragma once
+#include "ComponentsCommon.h"
+
+namespace havana::spatial
+{
+	// Finds entities by their world space position. Every entity is a sphere around the origin of its
+	// transform (a point until set_radius() is called). Moving entities are kept in a hashed grid that is
+	// updated from the transforms that changed in a frame. Entities that are marked static are kept in
+	// a bounding volume hierarchy, which is only rebuilt when static entities are added, moved or removed.
+
+	struct sphere
+	{
+		math::v3		center;
+		f32				radius;
+	};
+
+	// Planes are (normal, distance) with normals that point inwards: a point p is inside
+	// when dot(normal, p) + distance >= 0 for all six planes.
+	struct frustum
+	{
+		math::v4		planes[6];
+	};
+
+	struct ray
+	{
+		math::v3		origin;
+		math::v3		direction;	// normalized
+		f32				length;
+	};
+
+	// Results of a batch of queries. The entities found by query i are ids[offsets[i]] to ids[offsets[i + 1] - 1].
+	struct query_results
+	{
+		utl::vector<game_entity::entity_id>	ids;
+		utl::vector<u32>					offsets;
+
+		[[nodiscard]] u32 count(u32 query) const { return offsets[query + 1] - offsets[query]; }
+		[[nodiscard]] const game_entity::entity_id* begin(u32 query) const { return ids.data() + offsets[query]; }
+	};
+
+	void set_radius(game_entity::entity_id id, f32 radius);
+	// Static entities can still move, but every change rebuilds the hierarchy of static entities.
+	void set_static(game_entity::entity_id id, bool is_static);
+	void remove(game_entity::entity_id id);
+
+	// Brings the index up to date with the transforms that changed in the current frame. Must be
+	// called after the simulation is done writing transforms and before transform::end_frame().
+	void update();
+
+	// Entities whose sphere intersects the query volume. The index must not change while queries run,
+	// but queries can run on several threads at the same time.
+	void query(const sphere* const spheres, u32 count, query_results& results);
+	void query(const frustum* const frustums, u32 count, query_results& results);
+	// Hits of a ray are sorted by distance.
+	void query(const ray* const rays, u32 count, query_results& results);
+
+	namespace detail
+	{
+		// Spatial index of one world. See World.h.
+		struct world_data;
+		world_data* create_world();
+		void remove_world(world_data* const data);
+		void set_current_world(world_data* const data);
+
+		// World snapshots. See world::save_snapshot().
+		u64 snapshot_size(const world_data* const data);
+		void save_world(const world_data* const data, utl::blob_stream_writer& writer);
+		void restore_world(world_data* const data, utl::blob_stream_reader& reader);
+	}
+}
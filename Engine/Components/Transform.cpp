@@ -1,41 +1,312 @@
+#include <thread>
+#include <atomic>
 #include "Transform.h"
 #include "Entity.h"
+#include "World.h"
+#include "Jobs/Jobs.h"
 
 namespace havana::transform
 {
 	namespace
 	{
-		utl::vector<math::m4x4>	to_world;
-		utl::vector<math::m4x4>	inv_world;
-		utl::vector<math::v4>	rotations;
-		utl::vector<math::v3>	orientations;
-		utl::vector<math::v3>	positions;
-		utl::vector<math::v3>	scales;
-		utl::vector<u8>			has_transform;
-		utl::vector<u8>			changes_from_previous_frame;
-		u8						read_write_flag;
+		// Read-only copies of the matrices and change flags of the last published frames.
+		// The render side reads the latest snapshot while the simulation writes the next frame.
+		struct transform_snapshot
+		{
+			utl::vector<math::m3x4>	to_world;
+			utl::vector<math::m3x3>	inv_world;
+			utl::vector<u8>			changes;
+			// The same changes as a dense list of entity ids and as one bit per entity index.
+			utl::vector<game_entity::entity_id>	changed_ids;
+			utl::vector<u64>		changed_bits;
+			// Number of the last frame in which each transform changed, up to this snapshot's frame.
+			utl::vector<u64>		change_frames;
+			u64						frame{ 0 };
+		};
+	} // anonymous namespace
+
+	namespace detail
+	{
+		struct world_data
+		{
+			// NOTE: world matrices are affine, so we only store their first three columns (transposed into
+			//		 the rows of a 3x4 matrix). Inverse world matrices have no translation either, which
+			//		 leaves a 3x3 matrix. This takes 84 bytes per transform instead of 128.
+			utl::vector<math::m3x4>	to_world;
+			utl::vector<math::m3x3>	inv_world;
+			utl::vector<math::v4>	rotations;
+			utl::vector<math::v3>	orientations;
+			utl::vector<math::v3>	positions;
+			utl::vector<math::v3>	scales;
+			utl::vector<u8>			has_transform;
+			utl::vector<u8>			changes_from_previous_frame;
+			utl::vector<game_entity::entity_id>	entity_ids;
+
+			// Hierarchy links, stored as entity indices (u32_invalid_id when there is no such link).
+			// Children of a transform form a singly linked list through next_siblings.
+			utl::vector<u32>		parents;
+			utl::vector<u32>		first_children;
+			utl::vector<u32>		next_siblings;
+			utl::vector<u32>		depths;
+
+			// NOTE: contains the index of every transform with has_transform == 0, grouped by hierarchy depth.
+			//		 Processing the groups in depth order guarantees that parents are up to date before their children.
+			utl::vector<utl::vector<u32>>	dirty_indices;
+
+			// Indices of transforms whose change flags became non-zero during the current frame.
+			utl::vector<u32>		changed_indices;
+
+			transform_snapshot		snapshots[snapshot_count];
+			// NOTE: changed_history[i] holds the changed indices of the frame that was published in snapshots[i].
+			utl::vector<u32>		changed_history[snapshot_count];
+			// Number of the last published frame in which each transform changed (frames count from 1).
+			utl::vector<u64>		change_frames;
+			u64						frame_index{ 0 };
+			u32						published_snapshot{ u32_invalid_id };
+			// NOTE: atomic, so readers can look it up without the lock while they hold a snapshot.
+			std::atomic<u32>		reader_snapshot{ u32_invalid_id };
+			std::mutex				snapshot_mutex;
+		};
+	} // detail namespace
+
+	namespace
+	{
+		using detail::world_data;
+
+		// NOTE: null until the thread first uses the transform system or makes a world current.
+		thread_local world_data*	current_world{ nullptr };
+
+		world_data&
+		current()
+		{
+			if (!current_world) world::set_current(world::default_world());
+			return *current_world;
+		}
+
+		// A batch of transforms of one hierarchy level for the matrix jobs.
+		struct matrix_job_data
+		{
+			world_data*				state;
+			const utl::vector<u32>*	indices;
+		};
 
+		constexpr u32			matrix_batch_size{ 1024 };
+		static_assert((matrix_batch_size & 3) == 0, "Batch size must be a multiple of 4.");
+
+		// NOTE: calculates the local matrices. Transforms with a parent are combined with
+		//		 the parent's world matrix in apply_parent_transforms().
 		void
-		calculate_transform_matrices(id::id_type index)
+		calculate_transform_matrices(world_data& state, id::id_type index)
 		{
-			assert(rotations.size() >= index);
-			assert(positions.size() >= index);
-			assert(scales.size() >= index);
+			assert(state.rotations.size() >= index);
+			assert(state.positions.size() >= index);
+			assert(state.scales.size() >= index);
 
 			using namespace DirectX;
-			XMVECTOR r{ XMLoadFloat4(&rotations[index]) };
-			XMVECTOR t{ XMLoadFloat3(&positions[index]) };
-			XMVECTOR s{ XMLoadFloat3(&scales[index]) };
+			XMVECTOR r{ XMLoadFloat4(&state.rotations[index]) };
+			XMVECTOR t{ XMLoadFloat3(&state.positions[index]) };
+			XMVECTOR s{ XMLoadFloat3(&state.scales[index]) };
 
 			XMMATRIX world{ XMMatrixAffineTransformation(s, XMQuaternionIdentity(), r, t) };
-			XMStoreFloat4x4(&to_world[index], world);
+			XMStoreFloat3x4(&state.to_world[index], world);
 
 			// NOTE: (F. Luna) Intro to DirectX 12, section 8.2.2
 			world.r[3] = XMVectorSet(0.f, 0.f, 0.f, 1.f);
 			XMMATRIX inverse_world{ XMMatrixInverse(nullptr, world) };
-			XMStoreFloat4x4(&inv_world[index], inverse_world);
+			XMStoreFloat3x3(&state.inv_world[index], inverse_world);
+
+			state.has_transform[index] = 1;
+		}
+
+		// Calculates world and inverse world matrices of four transforms at once. The rotation, position and
+		// scale of the four transforms are transposed so that each SIMD lane holds the data of one transform.
+		// NOTE: we don't need a general matrix inverse, because the upper 3x3 of the world matrix is S*R
+		//		 and its inverse is R^T * S^-1. Like in calculate_transform_matrices(), the inverse world
+		//		 matrix has no translation.
+		void
+		calculate_transform_matrices_x4(world_data& state, const u32* const indices)
+		{
+			using namespace DirectX;
+			const XMMATRIX q{ XMMatrixTranspose(XMMATRIX{
+				XMLoadFloat4(&state.rotations[indices[0]]), XMLoadFloat4(&state.rotations[indices[1]]),
+				XMLoadFloat4(&state.rotations[indices[2]]), XMLoadFloat4(&state.rotations[indices[3]]) }) };
+			const XMMATRIX t{ XMMatrixTranspose(XMMATRIX{
+				XMLoadFloat3(&state.positions[indices[0]]), XMLoadFloat3(&state.positions[indices[1]]),
+				XMLoadFloat3(&state.positions[indices[2]]), XMLoadFloat3(&state.positions[indices[3]]) }) };
+			const XMMATRIX s{ XMMatrixTranspose(XMMATRIX{
+				XMLoadFloat3(&state.scales[indices[0]]), XMLoadFloat3(&state.scales[indices[1]]),
+				XMLoadFloat3(&state.scales[indices[2]]), XMLoadFloat3(&state.scales[indices[3]]) }) };
+
+			const XMVECTOR x{ q.r[0] };
+			const XMVECTOR y{ q.r[1] };
+			const XMVECTOR z{ q.r[2] };
+			const XMVECTOR w{ q.r[3] };
+			const XMVECTOR x2{ XMVectorAdd(x, x) };
+			const XMVECTOR y2{ XMVectorAdd(y, y) };
+			const XMVECTOR z2{ XMVectorAdd(z, z) };
+			const XMVECTOR one{ XMVectorSplatOne() };
+			const XMVECTOR zero{ XMVectorZero() };
+
+			// Same rotation matrix as XMMatrixRotationQuaternion(), one element per vector.
+			const XMVECTOR xy{ XMVectorMultiply(x, y2) };
+			const XMVECTOR xz{ XMVectorMultiply(x, z2) };
+			const XMVECTOR yz{ XMVectorMultiply(y, z2) };
+			const XMVECTOR r00{ XMVectorNegativeMultiplySubtract(y, y2, XMVectorNegativeMultiplySubtract(z, z2, one)) };
+			const XMVECTOR r11{ XMVectorNegativeMultiplySubtract(x, x2, XMVectorNegativeMultiplySubtract(z, z2, one)) };
+			const XMVECTOR r22{ XMVectorNegativeMultiplySubtract(x, x2, XMVectorNegativeMultiplySubtract(y, y2, one)) };
+			const XMVECTOR r01{ XMVectorMultiplyAdd(z2, w, xy) };
+			const XMVECTOR r10{ XMVectorNegativeMultiplySubtract(z2, w, xy) };
+			const XMVECTOR r02{ XMVectorNegativeMultiplySubtract(y2, w, xz) };
+			const XMVECTOR r20{ XMVectorMultiplyAdd(y2, w, xz) };
+			const XMVECTOR r12{ XMVectorMultiplyAdd(x2, w, yz) };
+			const XMVECTOR r21{ XMVectorNegativeMultiplySubtract(x2, w, yz) };
 
-			has_transform[index] = 1;
+			const XMVECTOR s0{ s.r[0] };
+			const XMVECTOR s1{ s.r[1] };
+			const XMVECTOR s2{ s.r[2] };
+			const XMVECTOR inv_s0{ XMVectorReciprocal(s0) };
+			const XMVECTOR inv_s1{ XMVectorReciprocal(s1) };
+			const XMVECTOR inv_s2{ XMVectorReciprocal(s2) };
+
+			// Transposing back gives us one matrix column per transform, which is exactly one row of a 3x4 matrix.
+			const XMMATRIX world_column0{ XMMatrixTranspose(XMMATRIX{
+				XMVectorMultiply(r00, s0), XMVectorMultiply(r10, s1), XMVectorMultiply(r20, s2), t.r[0] }) };
+			const XMMATRIX world_column1{ XMMatrixTranspose(XMMATRIX{
+				XMVectorMultiply(r01, s0), XMVectorMultiply(r11, s1), XMVectorMultiply(r21, s2), t.r[1] }) };
+			const XMMATRIX world_column2{ XMMatrixTranspose(XMMATRIX{
+				XMVectorMultiply(r02, s0), XMVectorMultiply(r12, s1), XMVectorMultiply(r22, s2), t.r[2] }) };
+
+			const XMMATRIX inv_row0{ XMMatrixTranspose(XMMATRIX{
+				XMVectorMultiply(r00, inv_s0), XMVectorMultiply(r10, inv_s1), XMVectorMultiply(r20, inv_s2), zero }) };
+			const XMMATRIX inv_row1{ XMMatrixTranspose(XMMATRIX{
+				XMVectorMultiply(r01, inv_s0), XMVectorMultiply(r11, inv_s1), XMVectorMultiply(r21, inv_s2), zero }) };
+			const XMMATRIX inv_row2{ XMMatrixTranspose(XMMATRIX{
+				XMVectorMultiply(r02, inv_s0), XMVectorMultiply(r12, inv_s1), XMVectorMultiply(r22, inv_s2), zero }) };
+
+			for (u32 i{ 0 }; i < 4; ++i)
+			{
+				const u32 index{ indices[i] };
+				math::m3x4& world{ state.to_world[index] };
+				XMStoreFloat4((XMFLOAT4*)world.m[0], world_column0.r[i]);
+				XMStoreFloat4((XMFLOAT4*)world.m[1], world_column1.r[i]);
+				XMStoreFloat4((XMFLOAT4*)world.m[2], world_column2.r[i]);
+				XMStoreFloat3x3(&state.inv_world[index], XMMATRIX{ inv_row0.r[i], inv_row1.r[i], inv_row2.r[i], zero });
+				state.has_transform[index] = 1;
+			}
+		}
+
+		// Combines the local matrices with the parent's world matrix:
+		// world = local * parent_world and inverse_world = parent_inverse_world * inverse_local.
+		void
+		apply_parent_transform(world_data& state, u32 index)
+		{
+			const u32 parent{ state.parents[index] };
+			if (parent == u32_invalid_id) return;
+
+			using namespace DirectX;
+			assert(state.has_transform[parent]);
+			const XMMATRIX world{ XMMatrixMultiply(XMLoadFloat3x4(&state.to_world[index]), XMLoadFloat3x4(&state.to_world[parent])) };
+			const XMMATRIX inverse_world{ XMMatrixMultiply(XMLoadFloat3x3(&state.inv_world[parent]), XMLoadFloat3x3(&state.inv_world[index])) };
+			XMStoreFloat3x4(&state.to_world[index], world);
+			XMStoreFloat3x3(&state.inv_world[index], inverse_world);
+		}
+
+		void
+		calculate_transform_matrices_batch(void* const data, u32 begin, u32 end)
+		{
+			const matrix_job_data& job{ *(const matrix_job_data* const)data };
+			world_data& state{ *job.state };
+			const u32* const indices{ job.indices->data() };
+			u32 i{ begin };
+			for (; i + 4 <= end; i += 4)
+			{
+				calculate_transform_matrices_x4(state, &indices[i]);
+			}
+
+			for (; i < end; ++i)
+			{
+				calculate_transform_matrices(state, indices[i]);
+			}
+
+			for (i = begin; i < end; ++i)
+			{
+				apply_parent_transform(state, indices[i]);
+			}
+		}
+
+		void mark_dirty(world_data& state, u32 index);
+
+		void
+		mark_changed(world_data& state, u32 index, u8 flags)
+		{
+			if (!state.changes_from_previous_frame[index])
+			{
+				state.changed_indices.emplace_back(index);
+			}
+
+			state.changes_from_previous_frame[index] |= flags;
+		}
+
+		// Recalculates the matrices of all transforms that changed since the last time they were calculated.
+		// The hierarchy is processed one depth level at a time and only the subtrees below changed transforms
+		// are visited: recalculating a transform marks its children dirty in the next level.
+		void
+		calculate_dirty_transforms(world_data& state)
+		{
+			for (u32 depth{ 0 }; depth < state.dirty_indices.size(); ++depth)
+			{
+				utl::vector<u32>& indices{ state.dirty_indices[depth] };
+				if (indices.empty()) continue;
+
+				// Skip entries of transforms that have moved to another level in the hierarchy.
+				// NOTE: a transform that moved away and back again is queued twice at the same depth. Setting
+				//		 has_transform here keeps only its first entry, so the parent matrix isn't applied twice
+				//		 and no two jobs write the same transform. The matrices are calculated right below.
+				u32 count{ 0 };
+				for (const u32 index : indices)
+				{
+					if (state.depths[index] == depth && !state.has_transform[index])
+					{
+						state.has_transform[index] = 1;
+						indices[count++] = index;
+					}
+				}
+				indices.resize(count);
+
+				matrix_job_data job{ &state, &indices };
+				if (count > matrix_batch_size)
+				{
+					jobs::counter counter{};
+					jobs::run(calculate_transform_matrices_batch, &job, count, matrix_batch_size, &counter);
+					jobs::wait(&counter);
+				}
+				else
+				{
+					calculate_transform_matrices_batch(&job, 0, count);
+				}
+
+				for (u32 i{ 0 }; i < count; ++i)
+				{
+					for (u32 child{ state.first_children[indices[i]] }; child != u32_invalid_id; child = state.next_siblings[child])
+					{
+						assert(state.depths[child] == depth + 1);
+						mark_dirty(state, child);
+						mark_changed(state, child, component_flags::rotation | component_flags::position);
+					}
+				}
+
+				indices.clear();
+			}
+		}
+
+		void
+		mark_dirty(world_data& state, u32 index)
+		{
+			if (state.has_transform[index])
+			{
+				state.has_transform[index] = 0;
+				state.dirty_indices[state.depths[index]].emplace_back(index);
+			}
 		}
 
 		math::v3
@@ -50,69 +321,355 @@ namespace havana::transform
 		}
 
 		void
-		set_rotation(transform_id id, const math::v4& rotation_quaternion)
+		set_rotation(world_data& state, transform_id id, const math::v4& rotation_quaternion)
 		{
 			const u32 index{ id::index(id) };
-			rotations[index] = rotation_quaternion;
-			orientations[index] = calculate_orientation(rotation_quaternion);
-			has_transform[index] = 0;
-			changes_from_previous_frame[index] |= component_flags::rotation;
+			state.rotations[index] = rotation_quaternion;
+			state.orientations[index] = calculate_orientation(rotation_quaternion);
+			mark_dirty(state, index);
+			mark_changed(state, index, component_flags::rotation);
 		}
 
 		void
-		set_orientation(transform_id, const math::v3&)
+		set_orientation(world_data&, transform_id, const math::v3&)
 		{
 
 		}
 
 		void
-		set_position(transform_id id, const math::v3& position)
+		set_position(world_data& state, transform_id id, const math::v3& position)
 		{
 			const u32 index{ id::index(id) };
-			positions[index] = position;
-			has_transform[index] = 0;
-			changes_from_previous_frame[index] |= component_flags::position;
+			state.positions[index] = position;
+			mark_dirty(state, index);
+			mark_changed(state, index, component_flags::position);
 		}
 		
 		void
-		set_scale(transform_id id, const math::v3& scale)
+		set_scale(world_data& state, transform_id id, const math::v3& scale)
 		{
 			const u32 index{ id::index(id) };
-			scales[index] = scale;
-			has_transform[index] = 0;
-			changes_from_previous_frame[index] |= component_flags::scale;
+			state.scales[index] = scale;
+			mark_dirty(state, index);
+			mark_changed(state, index, component_flags::scale);
+		}
+
+		void
+		set_depth(world_data& state, u32 index, u32 depth)
+		{
+			if (state.dirty_indices.size() <= depth)
+			{
+				state.dirty_indices.resize(depth + 1);
+			}
+
+			const u32 old_depth{ state.depths[index] };
+			state.depths[index] = depth;
+
+			// A dirty transform that moves to another level has to be added to that level's list.
+			// The entry in the old level's list is skipped by calculate_dirty_transforms().
+			if (!state.has_transform[index] && old_depth != depth)
+			{
+				state.dirty_indices[depth].emplace_back(index);
+			}
+		}
+
+		void
+		link_to_parent(world_data& state, u32 index, u32 parent)
+		{
+			state.parents[index] = parent;
+			state.first_children[index] = u32_invalid_id;
+			state.next_siblings[index] = u32_invalid_id;
+
+			if (parent == u32_invalid_id)
+			{
+				set_depth(state, index, 0);
+			}
+			else
+			{
+				assert(parent != index && state.has_transform.size() > parent);
+				state.next_siblings[index] = state.first_children[parent];
+				state.first_children[parent] = index;
+				set_depth(state, index, state.depths[parent] + 1);
+			}
+		}
+
+		void
+		unlink_from_parent(world_data& state, u32 index)
+		{
+			const u32 parent{ state.parents[index] };
+			if (parent == u32_invalid_id) return;
+
+			u32* link{ &state.first_children[parent] };
+			while (*link != index)
+			{
+				assert(*link != u32_invalid_id);
+				link = &state.next_siblings[*link];
+			}
+
+			*link = state.next_siblings[index];
+			state.parents[index] = u32_invalid_id;
+			state.next_siblings[index] = u32_invalid_id;
+		}
+
+		// Makes 'index' a root transform while keeping its current world transformation.
+		void
+		detach(world_data& state, u32 index)
+		{
+			using namespace DirectX;
+			assert(state.has_transform[index]);
+			unlink_from_parent(state, index);
+
+			XMVECTOR s, r, t;
+			XMMatrixDecompose(&s, &r, &t, XMLoadFloat3x4(&state.to_world[index]));
+			XMStoreFloat3(&state.scales[index], s);
+			XMStoreFloat4(&state.rotations[index], r);
+			XMStoreFloat3(&state.positions[index], t);
+			state.orientations[index] = calculate_orientation(state.rotations[index]);
+			mark_changed(state, index, (u8)component_flags::all);
+
+			// Move the whole subtree up in the hierarchy.
+			set_depth(state, index, 0);
+			mark_dirty(state, index);
+			utl::vector<u32> stack;
+			stack.emplace_back(index);
+			while (!stack.empty())
+			{
+				const u32 parent{ stack.back() };
+				stack.resize(stack.size() - 1);
+				for (u32 child{ state.first_children[parent] }; child != u32_invalid_id; child = state.next_siblings[child])
+				{
+					set_depth(state, child, state.depths[parent] + 1);
+					stack.emplace_back(child);
+				}
+			}
+		}
+
+		void
+		expand_matrices(const math::m3x4& world, const math::m3x3& inverse_world, math::m4x4& world_out, math::m4x4& inverse_world_out)
+		{
+			using namespace DirectX;
+			XMStoreFloat4x4(&world_out, XMLoadFloat3x4(&world));
+			XMStoreFloat4x4(&inverse_world_out, XMLoadFloat3x3(&inverse_world));
+		}
+
+		// Returns the snapshot that readers should use, or null if nothing has been published yet.
+		const transform_snapshot* const
+		read_snapshot(world_data& state)
+		{
+			// NOTE: reader_snapshot only changes in acquire_snapshot() and release_snapshot(), which the render
+			//		 side calls around all of its reads. In between, the snapshot is found without taking the lock.
+			const u32 reader_index{ state.reader_snapshot };
+			if (reader_index != u32_invalid_id) return &state.snapshots[reader_index];
+
+			std::lock_guard lock{ state.snapshot_mutex };
+			const u32 index{ state.published_snapshot };
+			return index != u32_invalid_id ? &state.snapshots[index] : nullptr;
+		}
+
+		// Copies the state of the frame that was just simulated into 'snapshot'.
+		// NOTE: snapshots are written in round-robin order, so 'snapshot' holds the frame that was published
+		//		 snapshot_count frames ago. Only transforms that changed since then need to be copied and those
+		//		 are exactly the ones in the change history of the last snapshot_count frames.
+		void
+		write_snapshot(world_data& state, u32 index)
+		{
+			transform_snapshot& snapshot{ state.snapshots[index] };
+			const u64 count{ state.to_world.size() };
+			if (snapshot.to_world.size() < count)
+			{
+				snapshot.to_world.resize(count);
+				snapshot.inv_world.resize(count);
+				snapshot.changes.resize(count);
+				snapshot.changed_bits.resize((count + 63) >> 6);
+				snapshot.change_frames.resize(count, 0);
+			}
+			if (state.change_frames.size() < count) state.change_frames.resize(count, 0);
+			snapshot.frame = state.frame_index + 1;
+
+			// Clear the flags of the frame we're overwriting and set the ones of the current frame.
+			utl::vector<u32>& history{ state.changed_history[index] };
+			for (const u32 i : history)
+			{
+				snapshot.changes[i] = 0;
+				snapshot.changed_bits[i >> 6] = 0;
+			}
+
+			history.swap(state.changed_indices);
+			state.changed_indices.clear();
+			snapshot.changed_ids.clear();
+			for (const u32 i : history)
+			{
+				snapshot.changes[i] = state.changes_from_previous_frame[i];
+				snapshot.changed_bits[i >> 6] |= u64{ 1 } << (i & 63);
+				snapshot.changed_ids.emplace_back(state.entity_ids[i]);
+				state.changes_from_previous_frame[i] = 0;
+				state.change_frames[i] = snapshot.frame;
+			}
+
+			for (const auto& frame_changes : state.changed_history)
+			{
+				for (const u32 i : frame_changes)
+				{
+					snapshot.to_world[i] = state.to_world[i];
+					snapshot.inv_world[i] = state.inv_world[i];
+					snapshot.change_frames[i] = state.change_frames[i];
+				}
+			}
+		}
+
+		void
+		set_changed(world_data& state, u32 index, u8 flags)
+		{
+			if (flags & component_flags::rotation)
+			{
+				state.orientations[index] = calculate_orientation(state.rotations[index]);
+			}
+			mark_dirty(state, index);
+			mark_changed(state, index, flags);
 		}
 	} // anonymous namespace
 
+	namespace detail
+	{
+		world_data*
+		create_world()
+		{
+			return new world_data{};
+		}
+
+		void
+		remove_world(world_data* const data)
+		{
+			assert(data);
+			delete data;
+		}
+
+		void
+		set_current_world(world_data* const data)
+		{
+			current_world = data;
+		}
+
+		u64
+		snapshot_size(const world_data* const data)
+		{
+			assert(data);
+			using writer = utl::blob_stream_writer;
+			u64 size{ writer::items_size(data->rotations) + writer::items_size(data->orientations) };
+			size += writer::items_size(data->positions) + writer::items_size(data->scales);
+			size += writer::items_size(data->has_transform) + writer::items_size(data->changes_from_previous_frame);
+			size += writer::items_size(data->entity_ids);
+			size += writer::items_size(data->parents) + writer::items_size(data->first_children);
+			size += writer::items_size(data->next_siblings) + writer::items_size(data->depths);
+			size += sizeof(u32);
+			for (const auto& indices : data->dirty_indices) size += writer::items_size(indices);
+			return size;
+		}
+
+		void
+		save_world(const world_data* const data, utl::blob_stream_writer& writer)
+		{
+			assert(data);
+			// NOTE: world matrices aren't saved. They're derived data and take up more than half of the
+			//		 transform data, so recalculating them after a restore is cheaper than copying them.
+			writer.write_items(data->rotations);
+			writer.write_items(data->orientations);
+			writer.write_items(data->positions);
+			writer.write_items(data->scales);
+			writer.write_items(data->has_transform);
+			writer.write_items(data->changes_from_previous_frame);
+			writer.write_items(data->entity_ids);
+			writer.write_items(data->parents);
+			writer.write_items(data->first_children);
+			writer.write_items(data->next_siblings);
+			writer.write_items(data->depths);
+			writer.write((u32)data->dirty_indices.size());
+			for (const auto& indices : data->dirty_indices) writer.write_items(indices);
+		}
+
+		void
+		restore_world(world_data* const data, utl::blob_stream_reader& reader)
+		{
+			assert(data);
+			world_data& state{ *data };
+			reader.read_items(state.rotations);
+			reader.read_items(state.orientations);
+			reader.read_items(state.positions);
+			reader.read_items(state.scales);
+			reader.read_items(state.has_transform);
+			reader.read_items(state.changes_from_previous_frame);
+			reader.read_items(state.entity_ids);
+			reader.read_items(state.parents);
+			reader.read_items(state.first_children);
+			reader.read_items(state.next_siblings);
+			reader.read_items(state.depths);
+			state.dirty_indices.resize(reader.read<u32>());
+			for (auto& indices : state.dirty_indices) reader.read_items(indices);
+			const u32 count{ (u32)state.rotations.size() };
+			state.to_world.resize(count);
+			state.inv_world.resize(count);
+
+			// The world matrices are calculated again and, because the snapshots of the render side
+			// still show the world before it was restored, every transform is published again.
+			// NOTE: the entities must be restored first.
+			state.changed_indices.clear();
+			state.changed_indices.reserve(count);
+			for (u32 i{ 0 }; i < count; ++i)
+			{
+				if (!game_entity::is_alive(state.entity_ids[i]))
+				{
+					state.changes_from_previous_frame[i] = 0;
+					continue;
+				}
+
+				mark_dirty(state, i);
+				state.changes_from_previous_frame[i] = (u8)component_flags::all;
+				state.changed_indices.emplace_back(i);
+			}
+		}
+	} // detail namespace
+
 	component
 	create(init_info info, game_entity::entity entity)
 	{
 		assert(entity.is_valid());
+		world_data& state{ current() };
 		const id::id_type entity_index{ id::index(entity.get_id()) };
+		const u32 parent_index{ id::is_valid(info.parent) ? id::index(info.parent) : u32_invalid_id };
+		assert(parent_index == u32_invalid_id || game_entity::is_alive(info.parent));
 
 		// If our entity has filled a hole in the vector of entities, put the
 		// transform component into that same slot in the vector of transforms
-		if (positions.size() > entity_index)
+		if (state.positions.size() > entity_index)
 		{
 			math::v4 rotation{ info.rotation };
-			rotations[entity_index] = rotation;
-			orientations[entity_index] = calculate_orientation(rotation);
-			positions[entity_index] = math::v3{ info.position };
-			scales[entity_index] = math::v3{ info.scale };
-			has_transform[entity_index] = 0;
-			changes_from_previous_frame[entity_index] = (u8)component_flags::all;
+			state.rotations[entity_index] = rotation;
+			state.orientations[entity_index] = calculate_orientation(rotation);
+			state.positions[entity_index] = math::v3{ info.position };
+			state.scales[entity_index] = math::v3{ info.scale };
+			state.entity_ids[entity_index] = entity.get_id();
+			link_to_parent(state, entity_index, parent_index);
+			mark_dirty(state, entity_index);
+			mark_changed(state, entity_index, (u8)component_flags::all);
 		}
 		else // If not, place it in the back with our entity
 		{
-			assert(positions.size() == entity_index);
-			to_world.emplace_back();
-			inv_world.emplace_back();
-			rotations.emplace_back(info.rotation);
-			orientations.emplace_back(calculate_orientation(math::v4{ info.rotation }));
-			positions.emplace_back(info.position);
-			scales.emplace_back(info.scale);
-			has_transform.emplace_back((u8)0);
-			changes_from_previous_frame.emplace_back((u8)component_flags::all);
+			assert(state.positions.size() == entity_index);
+			state.to_world.emplace_back();
+			state.inv_world.emplace_back();
+			state.rotations.emplace_back(info.rotation);
+			state.orientations.emplace_back(calculate_orientation(math::v4{ info.rotation }));
+			state.positions.emplace_back(info.position);
+			state.scales.emplace_back(info.scale);
+			state.has_transform.emplace_back((u8)0);
+			state.changes_from_previous_frame.emplace_back((u8)0);
+			state.entity_ids.emplace_back(entity.get_id());
+			state.parents.emplace_back();
+			state.first_children.emplace_back();
+			state.next_siblings.emplace_back();
+			state.depths.emplace_back(u32_invalid_id);
+			link_to_parent(state, entity_index, parent_index);
+			mark_changed(state, entity_index, (u8)component_flags::all);
 		}
 
 		// NOTE: each entity has a transform component. Therefore, id's for transform components
@@ -121,51 +678,205 @@ namespace havana::transform
 	}
 
 	void
-	remove([[maybe_unused]]component c)
+	create_batch(const init_info& info, const game_entity::entity* const entities, u32 count, const math::v3* const positions)
+	{
+		assert(entities && count);
+		world_data& state{ current() };
+		const u32 parent_index{ id::is_valid(info.parent) ? id::index(info.parent) : u32_invalid_id };
+		assert(parent_index == u32_invalid_id || game_entity::is_alive(info.parent));
+
+		const math::v4 rotation{ info.rotation };
+		const math::v3 orientation{ calculate_orientation(rotation) };
+		const math::v3 position{ info.position };
+		const math::v3 scale{ info.scale };
+
+		// Entities that didn't fill a hole are at the back of the entity pool. Their slots
+		// are added in one go and filled with the values that all instances share.
+		const u32 size{ (u32)state.positions.size() };
+		u32 new_size{ size };
+		for (u32 i{ 0 }; i < count; ++i)
+		{
+			assert(entities[i].is_valid());
+			const u32 index{ id::index(entities[i].get_id()) };
+			if (index >= new_size) new_size = index + 1;
+		}
+		assert(new_size - size <= count);
+
+		if (new_size > size)
+		{
+			state.to_world.resize(new_size);
+			state.inv_world.resize(new_size);
+			state.rotations.resize(new_size, rotation);
+			state.orientations.resize(new_size, orientation);
+			state.positions.resize(new_size, position);
+			state.scales.resize(new_size, scale);
+			state.has_transform.resize(new_size, (u8)0);
+			state.changes_from_previous_frame.resize(new_size, (u8)0);
+			state.entity_ids.resize(new_size);
+			state.parents.resize(new_size);
+			state.first_children.resize(new_size);
+			state.next_siblings.resize(new_size);
+			state.depths.resize(new_size, u32_invalid_id);
+		}
+
+		state.changed_indices.reserve(state.changed_indices.size() + count);
+		for (u32 i{ 0 }; i < count; ++i)
+		{
+			const u32 index{ id::index(entities[i].get_id()) };
+			if (index < size)
+			{
+				state.rotations[index] = rotation;
+				state.orientations[index] = orientation;
+				state.positions[index] = position;
+				state.scales[index] = scale;
+			}
+
+			if (positions) state.positions[index] = positions[i];
+			state.entity_ids[index] = entities[i].get_id();
+			link_to_parent(state, index, parent_index);
+			if (index < size) mark_dirty(state, index);
+			mark_changed(state, index, (u8)component_flags::all);
+		}
+	}
+
+	void
+	remove(component c)
 	{
 		assert(c.is_valid());
+		world_data& state{ current() };
+		const u32 index{ id::index(c.get_id()) };
+
+		if (state.first_children[index] != u32_invalid_id)
+		{
+			// Children of a removed transform become roots. We need up-to-date
+			// world matrices to keep them where they are.
+			calculate_dirty_transforms(state);
+			while (state.first_children[index] != u32_invalid_id)
+			{
+				detach(state, state.first_children[index]);
+			}
+		}
+
+		unlink_from_parent(state, index);
+	}
+
+	void
+	reserve(u32 count)
+	{
+		world_data& state{ current() };
+		state.to_world.reserve(count);
+		state.inv_world.reserve(count);
+		state.rotations.reserve(count);
+		state.orientations.reserve(count);
+		state.positions.reserve(count);
+		state.scales.reserve(count);
+		state.has_transform.reserve(count);
+		state.changes_from_previous_frame.reserve(count);
+		state.entity_ids.reserve(count);
+		state.parents.reserve(count);
+		state.first_children.reserve(count);
+		state.next_siblings.reserve(count);
+		state.depths.reserve(count);
+		state.changed_indices.reserve(count);
 	}
 
 	void
 	get_transform_matrices(const game_entity::entity_id id, math::m4x4& world, math::m4x4& inverse_world)
 	{
-		assert(game_entity::entity{ id }.is_valid());
+		get_transform_matrices(&id, 1, &world, &inverse_world);
+	}
 
-		const id::id_type entity_index{ id::index(id) };
-		if (!has_transform[entity_index])
+	void
+	get_transform_matrices(const game_entity::entity_id* const ids, u32 count, math::m4x4* const world, math::m4x4* const inverse_world)
+	{
+		assert(ids && count && world && inverse_world);
+		world_data& state{ current() };
+		const transform_snapshot* const snapshot{ read_snapshot(state) };
+		const u64 snapshot_size{ snapshot ? snapshot->to_world.size() : 0 };
+
+		for (u32 i{ 0 }; i < count; ++i)
 		{
-			calculate_transform_matrices(entity_index);
+			assert(game_entity::entity{ ids[i] }.is_valid());
+			const id::id_type entity_index{ id::index(ids[i]) };
+			if (entity_index < snapshot_size)
+			{
+				expand_matrices(snapshot->to_world[entity_index], snapshot->inv_world[entity_index], world[i], inverse_world[i]);
+			}
+			else
+			{
+				// NOTE: this transform hasn't been published yet. Readers run while the simulation writes
+				//		 the next frame, so they can't compute it here. It's published by the next end_frame().
+				DirectX::XMStoreFloat4x4(&world[i], DirectX::XMMatrixIdentity());
+				inverse_world[i] = world[i];
+			}
 		}
-
-		world = to_world[entity_index];
-		inverse_world = inv_world[entity_index];
 	}
 	
 	void
 	get_updated_components_flags(const game_entity::entity_id* const ids, u32 count, u8* const flags)
 	{
 		assert(ids && count && flags);
-		read_write_flag = 1;
+		world_data& state{ current() };
+		const transform_snapshot* const snapshot{ read_snapshot(state) };
+		const u64 snapshot_size{ snapshot ? snapshot->changes.size() : 0 };
 
 		for (u32 i{ 0 }; i < count; ++i)
 		{
 			assert(game_entity::entity{ ids[i] }.is_valid());
-			flags[i] = changes_from_previous_frame[id::index(ids[i])];
+			const id::id_type entity_index{ id::index(ids[i]) };
+			// NOTE: transforms that weren't published yet are reported as fully changed.
+			if (entity_index >= snapshot_size)
+			{
+				flags[i] = (u8)component_flags::all;
+				continue;
+			}
+
+			// Most transforms don't change, so we check the bits first to avoid touching the flags.
+			const bool has_changed{ ((snapshot->changed_bits[entity_index >> 6] >> (entity_index & 63)) & 1) != 0 };
+			flags[i] = has_changed ? snapshot->changes[entity_index] : 0;
 		}
 	}
 
+	const game_entity::entity_id*
+	get_changed_entities(u32& count)
+	{
+		world_data& state{ current() };
+		const transform_snapshot* const snapshot{ read_snapshot(state) };
+		count = snapshot ? (u32)snapshot->changed_ids.size() : 0;
+		return count ? snapshot->changed_ids.data() : nullptr;
+	}
+
+	const u64*
+	get_changed_bits(u32& entity_count)
+	{
+		world_data& state{ current() };
+		const transform_snapshot* const snapshot{ read_snapshot(state) };
+		entity_count = snapshot ? (u32)snapshot->changes.size() : 0;
+		return entity_count ? snapshot->changed_bits.data() : nullptr;
+	}
+
+	u64
+	get_snapshot_frame()
+	{
+		world_data& state{ current() };
+		const transform_snapshot* const snapshot{ read_snapshot(state) };
+		return snapshot ? snapshot->frame : 0;
+	}
+
+	const u64*
+	get_change_frames(u32& entity_count)
+	{
+		world_data& state{ current() };
+		const transform_snapshot* const snapshot{ read_snapshot(state) };
+		entity_count = snapshot ? (u32)snapshot->change_frames.size() : 0;
+		return entity_count ? snapshot->change_frames.data() : nullptr;
+	}
+
 	void
 	update(const component_cache* const cache, u32 count)
 	{
 		assert(cache && count);
-
-		// NOTE: clearing "changes_from_previous_frame" happens once every frame when there will be no reads and the caches are
-		//		 about to be applied by calling this function (i.e. the rest of the current frame will only have writes).
-		if (read_write_flag)
-		{
-			memset(changes_from_previous_frame.data(), 0, changes_from_previous_frame.size());
-			read_write_flag = 0;
-		}
+		world_data& state{ current() };
 
 		for (u32 i{ 0 }; i < count; ++i)
 		{
@@ -174,24 +885,155 @@ namespace havana::transform
 
 			if (c.flags & component_flags::rotation)
 			{
-				set_rotation(c.id, c.rotation);
+				set_rotation(state, c.id, c.rotation);
 			}
 
 			if (c.flags & component_flags::orientation)
 			{
-				set_orientation(c.id, c.orientation);
+				set_orientation(state, c.id, c.orientation);
 			}
 
 			if (c.flags & component_flags::position)
 			{
-				set_position(c.id, c.position);
+				set_position(state, c.id, c.position);
 			}
 
 			if (c.flags & component_flags::scale)
 			{
-				set_scale(c.id, c.scale);
+				set_scale(state, c.id, c.scale);
+			}
+		}
+
+		calculate_dirty_transforms(state);
+	}
+
+	void
+	get_frame_changes(utl::vector<game_entity::entity_id>& ids)
+	{
+		world_data& state{ current() };
+		calculate_dirty_transforms(state);
+
+		ids.clear();
+		for (const u32 index : state.changed_indices)
+		{
+			ids.emplace_back(state.entity_ids[index]);
+		}
+	}
+
+	void
+	get_world_positions(const game_entity::entity_id* const ids, u32 count, math::v3* const positions)
+	{
+		assert(ids && count && positions);
+		world_data& state{ current() };
+		for (u32 i{ 0 }; i < count; ++i)
+		{
+			const u32 index{ id::index(ids[i]) };
+			assert(state.has_transform[index]);
+			// NOTE: the rows of a world matrix are its transposed columns, so the translation is in the last column.
+			const math::m3x4& world{ state.to_world[index] };
+			positions[i] = math::v3{ world._14, world._24, world._34 };
+		}
+	}
+
+	view
+	get_view()
+	{
+		world_data& state{ current() };
+		view v{};
+		v.rotations = state.rotations.data();
+		v.orientations = state.orientations.data();
+		v.positions = state.positions.data();
+		v.scales = state.scales.data();
+		v.count = (u32)state.positions.size();
+		return v;
+	}
+
+	mutable_view
+	get_mutable_view()
+	{
+		world_data& state{ current() };
+		mutable_view v{};
+		v.rotations = state.rotations.data();
+		v.positions = state.positions.data();
+		v.scales = state.scales.data();
+		v.count = (u32)state.positions.size();
+		return v;
+	}
+
+	void
+	set_changed(const transform_id* const ids, u32 count, u32 flags)
+	{
+		assert(ids && count);
+		assert(!(flags & component_flags::orientation));
+		world_data& state{ current() };
+		flags &= component_flags::rotation | component_flags::position | component_flags::scale;
+		if (!flags) return;
+
+		for (u32 i{ 0 }; i < count; ++i)
+		{
+			assert(component{ ids[i] }.is_valid());
+			set_changed(state, id::index(ids[i]), (u8)flags);
+		}
+
+		calculate_dirty_transforms(state);
+	}
+
+	void
+	set_changed(const transform_id* const ids, const u8* const flags, u32 count)
+	{
+		assert(ids && flags && count);
+		world_data& state{ current() };
+		for (u32 i{ 0 }; i < count; ++i)
+		{
+			assert(component{ ids[i] }.is_valid() && !(flags[i] & component_flags::orientation));
+			const u8 f{ (u8)(flags[i] & (component_flags::rotation | component_flags::position | component_flags::scale)) };
+			if (f) set_changed(state, id::index(ids[i]), f);
+		}
+
+		calculate_dirty_transforms(state);
+	}
+
+	void
+	end_frame()
+	{
+		world_data& state{ current() };
+		calculate_dirty_transforms(state);
+
+		const u32 index{ (u32)(state.frame_index % snapshot_count) };
+
+		// Wait until the render side is done with the snapshot we're about to overwrite.
+		// NOTE: the reader can only acquire the latest published snapshot, which is never the one we write to.
+		while (true)
+		{
+			{
+				std::lock_guard lock{ state.snapshot_mutex };
+				if (state.reader_snapshot != index) break;
 			}
+			std::this_thread::yield();
 		}
+
+		write_snapshot(state, index);
+
+		std::lock_guard lock{ state.snapshot_mutex };
+		state.published_snapshot = index;
+		++state.frame_index;
+	}
+
+	void
+	acquire_snapshot()
+	{
+		world_data& state{ current() };
+		std::lock_guard lock{ state.snapshot_mutex };
+		assert(state.reader_snapshot == u32_invalid_id);
+		state.reader_snapshot = state.published_snapshot;
+	}
+
+	void
+	release_snapshot()
+	{
+		world_data& state{ current() };
+		std::lock_guard lock{ state.snapshot_mutex };
+		state.reader_snapshot = u32_invalid_id;
 	}
 
 	// Transform class method implementaions
@@ -199,27 +1041,27 @@ namespace havana::transform
 	component::rotation() const
 	{
 		assert(is_valid());
-		return rotations[id::index(_id)];
+		return current().rotations[id::index(_id)];
 	}
 
 	math::v3
 	component::orientation() const
 	{
 		assert(is_valid());
-		return orientations[id::index(_id)];
+		return current().orientations[id::index(_id)];
 	}
 
 	math::v3
 	component::position() const
 	{
 		assert(is_valid());
-		return positions[id::index(_id)];
+		return current().positions[id::index(_id)];
 	}
 
 	math::v3
 	component::scale() const
 	{
 		assert(is_valid());
-		return scales[id::index(_id)];
+		return current().scales[id::index(_id)];
 	}
 }
\ No newline at end of file
@@ -1,13 +1,22 @@
 #pragma once
 #include "ComponentsCommon.h"
+#include "Entity.h"
 
 namespace havana::transform
 {
+	// Number of frames for which matrices and change flags are kept. This matches the
+	// number of frames in flight in the renderer, so the render side can consume one
+	// frame while the simulation is already writing the next one.
+	constexpr u32 snapshot_count{ 3 };
+
 	struct init_info
 	{
 		f32 position[3]{};
 		f32 rotation[4]{};
 		f32 scale[3]{ 1.f, 1.f, 1.f };
+		// Optional parent entity. Position, rotation and scale are relative to the parent.
+		// The parent must be alive when the transform is created.
+		game_entity::entity_id parent{ id::invalid_id };
 	};
 
 	struct component_flags
@@ -33,9 +42,107 @@ namespace havana::transform
 		u32				flags;
 	};
 
+	// Direct access to the transform data for systems that process many transforms at once.
+	// There is one array per value, indexed by id::index() of the transform id. The arrays
+	// also contain the slots of removed transforms, which hold stale but harmless values.
+	// The pointers are valid until the next transform is created.
+	struct view
+	{
+		const math::v4*		rotations{ nullptr };
+		const math::v3*		orientations{ nullptr };
+		const math::v3*		positions{ nullptr };
+		const math::v3*		scales{ nullptr };
+		u32					count{ 0 };
+	};
+
+	// Same as view, but writable. Orientations are derived from rotations, so they aren't
+	// exposed here. Call set_changed() for every transform that was written to.
+	struct mutable_view
+	{
+		math::v4*			rotations{ nullptr };
+		math::v3*			positions{ nullptr };
+		math::v3*			scales{ nullptr };
+		u32					count{ 0 };
+	};
+
 	component create(init_info info, game_entity::entity entity);
+	// Creates the transforms of many entities with the same init_info. The ids of the transform components
+	// are the ids of the entities. 'positions' is optional and replaces info.position for each entity.
+	void create_batch(const init_info& info, const game_entity::entity* const entities, u32 count, const math::v3* const positions);
 	void remove(component c);
+	// Makes sure there is room for 'count' transforms without reallocating.
+	void reserve(u32 count);
+	// Matrices from the published snapshot (see acquire_snapshot()). Prefer the batch version, which looks up the
+	// snapshot only once. Transforms that haven't been published yet, because they were created during the
+	// current frame, get identity matrices.
 	void get_transform_matrices(const game_entity::entity_id id, math::m4x4& world, math::m4x4& inverse_world);
+	void get_transform_matrices(const game_entity::entity_id* const ids, u32 count, math::m4x4* const world, math::m4x4* const inverse_world);
 	void get_updated_components_flags(const game_entity::entity_id* const ids, u32 count, u8* const flags);
+	// Ids of the entities whose transform changed in the snapshot that is being read. Some of
+	// them may have been removed since. Valid until the snapshot is released.
+	const game_entity::entity_id* get_changed_entities(u32& count);
+	// One bit per entity index (64 per element), set for the transforms in get_changed_entities().
+	// 'entity_count' is the number of entities the snapshot covers; newer entities have no bit yet.
+	const u64* get_changed_bits(u32& entity_count);
+	// NOTE: the two functions above only hold the changes of the frame the snapshot was published in. The
+	//		 simulation can publish several frames before the render side acquires the next snapshot, so readers
+	//		 that keep state across snapshots should compare the change frames with the frame they saw last.
+	// Number of the frame the snapshot being read was published in, counted from 1 (0 if there is none yet).
+	u64 get_snapshot_frame();
+	// Number of the last frame in which each transform changed, indexed by entity index.
+	// 'entity_count' is the number of entities the snapshot covers; newer entities have no value yet.
+	const u64* get_change_frames(u32& entity_count);
 	void update(const component_cache* const cache, u32 count);
+	// Ids of the entities whose transform changed since the last end_frame(). The world matrices
+	// of those transforms are brought up to date first. 'ids' is cleared before it's filled.
+	void get_frame_changes(utl::vector<game_entity::entity_id>& ids);
+	// World space positions of the transforms, taken from their world matrices. The matrices
+	// have to be up to date (e.g. for the entities returned by get_frame_changes()).
+	void get_world_positions(const game_entity::entity_id* const ids, u32 count, math::v3* const positions);
+
+	view get_view();
+	mutable_view get_mutable_view();
+	// Marks values written through a mutable_view as changed. 'flags' is a combination of component_flags.
+	void set_changed(const transform_id* const ids, u32 count, u32 flags);
+	// Same as above, with separate flags for each transform.
+	void set_changed(const transform_id* const ids, const u8* const flags, u32 count);
+
+	// Calls 'func(index)' with the index of every transform in use, one dense chunk of
+	// entities at a time. Use the index to access the arrays of a view.
+	template<typename F>
+	void for_each(const F& func)
+	{
+		utl::vector<game_entity::entity_chunk> chunks;
+		game_entity::get_chunks(game_entity::component_bit(game_entity::component_type::transform), chunks);
+		for (const auto& chunk : chunks)
+		{
+			for (u32 i{ 0 }; i < chunk.count; ++i)
+			{
+				func((u32)id::index(chunk.transforms[i].get_id()));
+			}
+		}
+	}
+
+	// Publishes the matrices and change flags of the current frame. Must be called once per
+	// frame after the simulation is done writing transforms.
+	void end_frame();
+
+	// The render side calls these around the work for one frame. All reads between the two calls
+	// see the same snapshot, even if the simulation publishes new frames in the meantime.
+	void acquire_snapshot();
+	void release_snapshot();
+
+	namespace detail
+	{
+		// Transform storage of one world. See World.h.
+		struct world_data;
+		world_data* create_world();
+		void remove_world(world_data* const data);
+		void set_current_world(world_data* const data);
+
+		// World snapshots. See world::save_snapshot().
+		u64 snapshot_size(const world_data* const data);
+		void save_world(const world_data* const data, utl::blob_stream_writer& writer);
+		void restore_world(world_data* const data, utl::blob_stream_reader& reader);
+	}
 }
\ No newline at end of file
@@ -0,0 +1,241 @@
+#include "World.h"
+#include "Entity.h"
+#include "Transform.h"
+#include "Script.h"
+#include "Spatial.h"
+#include "Animation.h"
+#include "Jobs/TaskGraph.h"
+#include "Core/FrameMemory.h"
+
+namespace havana::world
+{
+	namespace detail
+	{
+		// NOTE: states are allocated separately, so pointers to them stay valid
+		//		 while other worlds are created and removed.
+		struct world_state
+		{
+			world_id							id{ id::invalid_id };
+			game_entity::detail::world_data*	entities{ nullptr };
+			transform::detail::world_data*		transforms{ nullptr };
+			script::detail::world_data*			scripts{ nullptr };
+			spatial::detail::world_data*		spatial{ nullptr };
+			animation::detail::world_data*		animations{ nullptr };
+			// Passed to the tasks of add_update_tasks().
+			const f32*							task_dt{ nullptr };
+			// Frame memory frame of the last update, see check_new_frame().
+			u64									update_frame{ 0 };
+		};
+	} // detail namespace
+
+	namespace // anonymous namespace
+	{
+		utl::handle_pool<std::unique_ptr<detail::world_state>>	worlds;
+		world_id												default_id{ id::invalid_id };
+		// NOTE: worlds can be created and removed from any thread.
+		std::mutex												worlds_mutex;
+		thread_local detail::world_state*						current_world{ nullptr };
+
+		detail::world_state* const
+		create_state()
+		{
+			auto state{ std::make_unique<detail::world_state>() };
+			state->entities = game_entity::detail::create_world();
+			state->transforms = transform::detail::create_world();
+			state->scripts = script::detail::create_world();
+			state->spatial = spatial::detail::create_world();
+			state->animations = animation::detail::create_world();
+
+			detail::world_state* const result{ state.get() };
+			result->id = world_id{ worlds.add(std::move(state)) };
+			return result;
+		}
+
+		detail::world_state* const
+		get_state(world_id id)
+		{
+			std::lock_guard lock{ worlds_mutex };
+			assert(id::is_valid(id) && worlds.is_alive(id));
+			return worlds[id].get();
+		}
+
+		// The systems allocate their scratch arrays from frame memory, which is only reclaimed when
+		// memory::begin_frame() starts a new frame. A world that is updated twice in the same frame
+		// means the host doesn't call begin_frame() and frame memory would grow without bound.
+		void
+		check_new_frame(detail::world_state* const state)
+		{
+			const u64 frame{ memory::current_frame() };
+			assert(state->update_frame != frame);
+			state->update_frame = frame;
+		}
+	} // anonymous namespace
+
+	namespace detail
+	{
+		world_state*
+		current_state()
+		{
+			return current_world;
+		}
+
+		void
+		set_current_state(world_state* const state)
+		{
+			current_world = state;
+			game_entity::detail::set_current_world(state ? state->entities : nullptr);
+			transform::detail::set_current_world(state ? state->transforms : nullptr);
+			script::detail::set_current_world(state ? state->scripts : nullptr);
+			spatial::detail::set_current_world(state ? state->spatial : nullptr);
+			animation::detail::set_current_world(state ? state->animations : nullptr);
+		}
+	} // detail namespace
+
+	world_id
+	create()
+	{
+		std::lock_guard lock{ worlds_mutex };
+		return create_state()->id;
+	}
+
+	void
+	remove(world_id id)
+	{
+		assert(id != default_id);
+		detail::world_state* const state{ get_state(id) };
+		assert(state != current_world);
+
+		{
+			// NOTE: script destructors may use the entities and transforms of their own world.
+			scope world_scope{ state };
+			script::detail::remove_world(state->scripts);
+			animation::detail::remove_world(state->animations);
+			spatial::detail::remove_world(state->spatial);
+			transform::detail::remove_world(state->transforms);
+			game_entity::detail::remove_world(state->entities);
+		}
+
+		std::lock_guard lock{ worlds_mutex };
+		worlds.remove(id);
+	}
+
+	bool
+	is_alive(world_id id)
+	{
+		std::lock_guard lock{ worlds_mutex };
+		return worlds.is_alive(id);
+	}
+
+	world_id
+	default_world()
+	{
+		std::lock_guard lock{ worlds_mutex };
+		if (!id::is_valid(default_id))
+		{
+			default_id = create_state()->id;
+		}
+
+		return default_id;
+	}
+
+	world_id
+	current()
+	{
+		if (!current_world) set_current(default_world());
+		return current_world->id;
+	}
+
+	void
+	set_current(world_id id)
+	{
+		detail::set_current_state(get_state(id));
+	}
+
+	void
+	update(world_id id, f32 dt)
+	{
+		scope world_scope{ id };
+		check_new_frame(current_world);
+		animation::update(dt);
+		script::update(dt);
+		spatial::update();
+		transform::end_frame();
+	}
+
+	u32
+	add_update_tasks(world_id id, jobs::task_graph& graph, const f32* const dt, const u32* const dependencies, u32 dependency_count)
+	{
+		assert(dt);
+		detail::world_state* const state{ get_state(id) };
+		// NOTE: a world can only be part of one graph, because its tasks get 'dt' from the world state.
+		assert(!state->task_dt || state->task_dt == dt);
+		state->task_dt = dt;
+
+		// NOTE: the stages write the same transforms, so they have to run one after the other.
+		//		 Each of them runs its own work on all threads.
+		const jobs::task_function animations{ [](void* const data)
+			{
+				scope world_scope{ (detail::world_state*)data };
+				check_new_frame((detail::world_state*)data);
+				animation::update(*((detail::world_state*)data)->task_dt);
+			} };
+		const jobs::task_function scripts{ [](void* const data)
+			{
+				scope world_scope{ (detail::world_state*)data };
+				script::update(*((detail::world_state*)data)->task_dt);
+			} };
+		const jobs::task_function spatial_index{ [](void* const data)
+			{
+				scope world_scope{ (detail::world_state*)data };
+				spatial::update();
+			} };
+		const jobs::task_function transforms{ [](void* const data)
+			{
+				scope world_scope{ (detail::world_state*)data };
+				transform::end_frame();
+			} };
+
+		u32 task{ graph.add({ animations, state, "animations" }, dependencies, dependency_count) };
+		task = graph.add({ scripts, state, "scripts" }, { task });
+		task = graph.add({ spatial_index, state, "spatial index" }, { task });
+		return graph.add({ transforms, state, "transforms" }, { task });
+	}
+
+	void
+	save_snapshot(world_id id, utl::vector<u8>& buffer)
+	{
+		scope world_scope{ id };
+		const detail::world_state* const state{ current_world };
+		const u64 size{ game_entity::detail::snapshot_size(state->entities) + transform::detail::snapshot_size(state->transforms) +
+			spatial::detail::snapshot_size(state->spatial) + animation::detail::snapshot_size(state->animations) +
+			script::detail::snapshot_size(state->scripts) };
+		buffer.resize(size);
+
+		utl::blob_stream_writer writer{ buffer.data(), buffer.size() };
+		game_entity::detail::save_world(state->entities, writer);
+		transform::detail::save_world(state->transforms, writer);
+		spatial::detail::save_world(state->spatial, writer);
+		animation::detail::save_world(state->animations, writer);
+		script::detail::save_world(state->scripts, writer);
+		assert(writer.offset() == size);
+	}
+
+	void
+	restore_snapshot(world_id id, const utl::vector<u8>& buffer)
+	{
+		assert(!buffer.empty());
+		scope world_scope{ id };
+		const detail::world_state* const state{ current_world };
+
+		// NOTE: script destructors may still use the entities and transforms they had before the restore.
+		script::detail::destroy_scripts(state->scripts);
+
+		utl::blob_stream_reader reader{ buffer.data() };
+		game_entity::detail::restore_world(state->entities, reader);
+		transform::detail::restore_world(state->transforms, reader);
+		spatial::detail::restore_world(state->spatial, reader);
+		animation::detail::restore_world(state->animations, reader);
+		script::detail::restore_world(state->scripts, reader);
+		assert(reader.offset() == buffer.size());
+	}
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include "ComponentsCommon.h"
+
+namespace havana::jobs { class task_graph; }
+
+namespace havana::world
+{
+	DEFINE_TYPED_ID(world_id);
+
+	// A world owns a complete set of entities, transforms, scripts, animations and a spatial index. Functions of
+	// these systems work on the current world of the calling thread, which is the default world
+	// until another one is made current. Different worlds can be updated on
+	// different threads at the same time (e.g. streaming sub-levels or editor preview worlds).
+	world_id create();
+	// Frees all entities, transforms and scripts of the world at once. Scripts are destroyed, but
+	// entities aren't removed one by one. The world must not be current on any thread.
+	void remove(world_id id);
+	bool is_alive(world_id id);
+
+	world_id default_world();
+	world_id current();
+	void set_current(world_id id);
+
+	// Runs the animations and scripts of the world, updates its spatial index and publishes its transforms
+	// for the render side. Call it at most once per frame, after memory::begin_frame() has started the frame:
+	// the systems allocate their scratch arrays from frame memory, which is never reclaimed otherwise.
+	void update(world_id id, f32 dt);
+	// Adds the stages of update() to a task graph, so that they can run at the same time as other work of
+	// the frame (e.g. the updates of other worlds). 'dt' is read when the graph runs. The stages start
+	// after the tasks in 'dependencies'. Returns the last stage, which publishes the transforms.
+	// Like update(), the graph must run at most once per frame, after memory::begin_frame().
+	// The world must stay alive as long as the graph is used.
+	u32 add_update_tasks(world_id id, jobs::task_graph& graph, const f32* const dt,
+		const u32* const dependencies = nullptr, u32 dependency_count = 0);
+
+	// Copies the complete simulation state of a world (entities, transforms, scripts, animations and the spatial index)
+	// into 'buffer', e.g. for rollback, replays or reloading a scene while profiling. Reuse the same buffer
+	// for every snapshot, so it doesn't have to grow each time. Snapshots contain pointers into the
+	// running program, so they can't be written to disk and loaded by another run.
+	void save_snapshot(world_id id, utl::vector<u8>& buffer);
+	// Puts a world back into the state of a snapshot. Everything but the scripts is restored with bulk
+	// copies. Scripts are constructed again and get their own state back from entity_script::restore().
+	// Their constructors must not create or remove entities. Snapshots can only be saved and restored
+	// between updates of the world.
+	void restore_snapshot(world_id id, const utl::vector<u8>& buffer);
+
+	namespace detail
+	{
+		struct world_state;
+
+		// Faster versions of current() and set_current() for jobs that have to run in the world
+		// of the thread that submitted them. They don't need to look up the world.
+		world_state* current_state();
+		void set_current_state(world_state* const state);
+	}
+
+	// Makes a world current on the calling thread for the lifetime of the scope.
+	class scope
+	{
+	public:
+		explicit scope(world_id id) : _previous{ detail::current_state() } { set_current(id); }
+		explicit scope(detail::world_state* const state) : _previous{ detail::current_state() } { detail::set_current_state(state); }
+		~scope() { detail::set_current_state(_previous); }
+		DISABLE_COPY_AND_MOVE(scope);
+
+	private:
+		detail::world_state* const	_previous;
+	};
+}
@@ -1,12 +1,22 @@
 #pragma once
 #include "CommonHeaders.h"
+#include "EngineAPI/GameEntity.h"
 
-#if !defined(SHIPPING) && defined(_WIN64)
+#if !defined(SHIPPING) && (defined(_WIN64) || defined(__linux__))
 namespace havana::content
 {
 	bool load_game();
 	void unload_game();
 
+	// A prefab is the component data of one entity, read from a file with the same layout as an entity
+	// in game.bin (without the entity type). The file is read once and the prefab can then be
+	// instantiated any number of times without parsing it or looking up its script again.
+	DEFINE_TYPED_ID(prefab_id);
+	prefab_id load_prefab(const char* path);
+	void unload_prefab(prefab_id id);
+	// Creates 'count' entities from the prefab. 'positions' is optional and places each instance.
+	void instantiate_prefab(prefab_id id, u32 count, game_entity::entity* const instances, const math::v3* const positions = nullptr);
+
 	bool load_engine_shaders(std::unique_ptr<u8[]>& shaders, u64& size);
 }
 #endif // !defined(SHIPPING)
\ No newline at end of file
@@ -22,16 +22,34 @@ namespace havana::content
 			count
 		};
 
+		// Component data of one entity, read from a file once. The same data is used
+		// for every entity that is created from it.
+		struct prefab
+		{
+			transform::init_info	transform{};
+			script::init_info		script{};
+			bool					has_transform{ false };
+			bool					has_script{ false };
+
+			game_entity::entity_info entity_info()
+			{
+				game_entity::entity_info info{};
+				info.transform = has_transform ? &transform : nullptr;
+				info.script = has_script ? &script : nullptr;
+				return info;
+			}
+		};
+
 		utl::vector<game_entity::entity> entities;
-		transform::init_info transform_info{};
-		script::init_info script_info{};
+		utl::handle_pool<prefab> prefabs;
 
-		bool read_transform(const u8*& data, game_entity::entity_info& info)
+		bool read_transform(const u8*& data, prefab& entity_prefab)
 		{
 			using namespace DirectX;
 			f32 rotation[3];
+			transform::init_info& transform_info{ entity_prefab.transform };
 
-			assert(!info.transform);
+			assert(!entity_prefab.has_transform);
 
 			memcpy(&transform_info.position[0], data, sizeof(transform_info.position)); data += sizeof(transform_info.position);
 			memcpy(&rotation[0], data, sizeof(rotation)); data += sizeof(rotation);
@@ -44,14 +62,15 @@ namespace havana::content
 			XMStoreFloat4A(&rot_quat, quat);
 			memcpy(&transform_info.rotation[0], &rot_quat.x, sizeof(transform_info.rotation));
 
-			info.transform = &transform_info;
+			entity_prefab.has_transform = true;
 
 			return true;
 		}
 
-		bool read_script(const u8*& data, game_entity::entity_info& info)
+		bool read_script(const u8*& data, prefab& entity_prefab)
 		{
-			assert(!info.script);
+			assert(!entity_prefab.has_script);
+			script::init_info& script_info{ entity_prefab.script };
 			const u32 name_length{ *data }; data += sizeof(u32);
 
 			if (!name_length) return false;
@@ -65,15 +84,34 @@ namespace havana::content
 			script_name[name_length] = 0;
 			script_info.script_creator = script::detail::get_script_creator(script::detail::string_hash()(script_name));
 
-			info.script = &script_info;
+			entity_prefab.has_script = true;
 
 			return script_info.script_creator != nullptr;
 		}
 
-		using component_reader = bool(*)(const u8*&, game_entity::entity_info&);
+		using component_reader = bool(*)(const u8*&, prefab&);
 		component_reader component_readers[]{ read_transform, read_script };
 		static_assert(_countof(component_readers) == component_type::count);
 
+		// Reads the components of one entity: the number of components, followed by the type and data of each.
+		bool read_prefab(const u8*& at, prefab& entity_prefab)
+		{
+			constexpr u32 su32{ sizeof(u32) };
+			const u32 num_components{ *at }; at += su32;
+			if (!num_components) return false;
+
+			for (u32 component_index{ 0 }; component_index < num_components; ++component_index)
+			{
+				const u32 component_type{ *at }; at += su32;
+				assert(component_type < component_type::count);
+				if (!component_readers[component_type](at, entity_prefab)) return false;
+			}
+
+			// All entities must have a transform component
+			assert(entity_prefab.has_transform);
+			return entity_prefab.has_transform;
+		}
+
 		bool read_file(std::filesystem::path path, std::unique_ptr<u8[]>& data, u64& size)
 		{
 			if (!std::filesystem::exists(path)) return false;
@@ -110,23 +148,14 @@ namespace havana::content
 
 		for (u32 entity_index{ 0 }; entity_index < num_entities; ++entity_index)
 		{
-			game_entity::entity_info info{};
+			prefab entity_prefab{};
 			//const u32 entity_type{ *at };
 			// skip over entity type (for now):
 			at += su32;
-			const u32 num_components{ *at }; at += su32;
-			if (!num_components) return false;
-
-			for (u32 component_index{ 0 }; component_index < num_components; ++component_index)
-			{
-				const u32 component_type{ *at }; at += su32;
-				assert(component_type < component_type::count);
-				if (!component_readers[component_type](at, info)) return false;
-			}
+			if (!read_prefab(at, entity_prefab)) return false;
 
 			// create entity
-			assert(info.transform);
-			game_entity::entity entity{ game_entity::create(info) };
+			game_entity::entity entity{ game_entity::create(entity_prefab.entity_info()) };
 			if (!entity.is_valid()) return false;
 			entities.emplace_back(entity);
 		}
@@ -137,10 +166,37 @@ namespace havana::content
 
 	void unload_game()
 	{
-		for (auto entity : entities)
-		{
-			game_entity::remove(entity.get_id());
-		}
+		if (entities.empty()) return;
+
+		game_entity::remove_batch(entities.data(), (u32)entities.size());
+		entities.clear();
+	}
+
+	prefab_id load_prefab(const char* path)
+	{
+		std::unique_ptr<u8[]> prefab_data{};
+		u64 size{ 0 };
+		if (!read_file(path, prefab_data, size)) return prefab_id{ id::invalid_id };
+		assert(prefab_data.get());
+
+		const u8* at{ prefab_data.get() };
+		prefab entity_prefab{};
+		if (!read_prefab(at, entity_prefab)) return prefab_id{ id::invalid_id };
+		assert(at == prefab_data.get() + size);
+
+		return prefab_id{ prefabs.add(entity_prefab) };
+	}
+
+	void unload_prefab(prefab_id id)
+	{
+		assert(id::is_valid(id));
+		prefabs.remove(id);
+	}
+
+	void instantiate_prefab(prefab_id id, u32 count, game_entity::entity* const instances, const math::v3* const positions)
+	{
+		assert(id::is_valid(id) && count && instances);
+		game_entity::instantiate(prefabs[id].entity_info(), count, instances, positions);
 	}
 
 	bool load_engine_shaders(std::unique_ptr<u8[]>& shaders, u64& size)
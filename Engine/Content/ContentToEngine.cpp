@@ -423,10 +423,9 @@ namespace havana::content
 	}
 
 	void
-	get_lod_offsets(const id::id_type* const geometry_ids, const f32* const thresholds, u32 id_count, utl::vector<lod_offset>& offsets)
+	get_lod_offsets(const id::id_type* const geometry_ids, const f32* const thresholds, u32 id_count, lod_offset* const offsets)
 	{
-		assert(geometry_ids && thresholds && id_count);
-		assert(offsets.empty());
+		assert(geometry_ids && thresholds && id_count && offsets);
 
 		std::lock_guard lock{ geometry_mutex };
 
@@ -435,13 +434,13 @@ namespace havana::content
 			u8* const pointer{ geometry_hierarchies[geometry_ids[i]] };
 			if ((uintptr_t)pointer & single_mesh_marker)
 			{
-				offsets.emplace_back(lod_offset{ 0, 1 });
+				offsets[i] = lod_offset{ 0, 1 };
 			}
 			else
 			{
 				geometry_hierarchy_stream stream{ pointer };
 				const u32 lod{ stream.lod_from_threshold(thresholds[i]) };
-				offsets.emplace_back(stream.lod_offsets()[lod]);
+				offsets[i] = stream.lod_offsets()[lod];
 			}
 		}
 	}
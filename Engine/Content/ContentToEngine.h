@@ -47,5 +47,5 @@ namespace havana::content
 	compiled_shader_ptr get_shader(id::id_type id, u32 shader_key);
 
 	void get_submesh_gpu_ids(id::id_type geometry_content_id, u32 id_count, id::id_type* const gpu_ids);
-	void get_lod_offsets(const id::id_type* const geometry_ids, const f32* const thresholds, u32 id_count, utl::vector<lod_offset>& offsets);
+	void get_lod_offsets(const id::id_type* const geometry_ids, const f32* const thresholds, u32 id_count, lod_offset* const offsets);
 }
\ No newline at end of file
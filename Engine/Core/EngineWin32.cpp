@@ -1,7 +1,10 @@
 #if !defined(SHIPPING) && defined(_WIN64)
 
 #include "Content/ContentLoader.h"
-#include "Components/Script.h"
+#include "Components/World.h"
+#include "Core/FrameMemory.h"
+#include "Jobs/Jobs.h"
+#include "Jobs/TaskGraph.h"
 #include "Platforms/PlatformTypes.h"
 #include "Platforms/Platform.h" 
 #include "Graphics/Renderer.h"
@@ -12,6 +15,9 @@ using namespace havana;
 namespace
 {
 	graphics::render_surface game_window{};
+	// NOTE: the work of a frame. Independent stages (e.g. updates of different worlds) overlap.
+	jobs::task_graph frame_graph{};
+	f32 frame_dt{ 10.0f };
 	
 	LRESULT win_proc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam)
 	{
@@ -43,7 +49,9 @@ namespace
 
 bool engine_initialize()
 {
+	if (!havana::jobs::initialize()) return false;
 	if(!havana::content::load_game()) return false;
+	havana::world::add_update_tasks(havana::world::current(), frame_graph, &frame_dt);
 
 	platform::window_init_info info
 	{
@@ -58,14 +66,17 @@ bool engine_initialize()
 
 void engine_update()
 {
-	havana::script::update(10.0f);
+	havana::memory::begin_frame();
+	frame_graph.run();
 	std::this_thread::sleep_for(std::chrono::milliseconds(10));
 }
 
 void engine_shutdown()
 {
 	platform::remove_window(game_window.window.get_id());
+	frame_graph.clear();
 	havana::content::unload_game();
+	havana::jobs::shutdown();
 }
 
 #endif // !defined(SHIPPING)
\ No newline at end of file
@@ -0,0 +1,60 @@
+#include "FrameMemory.h"
+
+namespace havana::memory
+{
+	namespace // anonymous namespace
+	{
+		// NOTE: the first frame is 'frame_count', so that no slot looks like it was used in the current frame.
+		std::atomic<u64>					frame_number{ frame_count };
+
+		// NOTE: each thread resets its own allocators the first time it allocates in a new frame,
+		//		 which is why begin_frame() doesn't need to know which threads allocate.
+		struct thread_frames
+		{
+			utl::linear_allocator			allocators[frame_count];
+			u64								frames[frame_count]{};
+		};
+
+		thread_local thread_frames			frames;
+
+		utl::linear_allocator&
+		current_allocator()
+		{
+			const u64 frame{ frame_number.load(std::memory_order_relaxed) };
+			const u32 slot{ (u32)(frame % frame_count) };
+			if (frames.frames[slot] != frame)
+			{
+				// This slot was last used 'frame_count' or more frames ago.
+				assert(frames.frames[slot] + frame_count <= frame);
+				frames.allocators[slot].reset();
+				frames.frames[slot] = frame;
+			}
+
+			return frames.allocators[slot];
+		}
+	} // anonymous namespace
+
+	void
+	begin_frame()
+	{
+		frame_number.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	u64
+	current_frame()
+	{
+		return frame_number.load(std::memory_order_relaxed);
+	}
+
+	void*
+	frame_allocate(u64 size, u64 alignment)
+	{
+		return current_allocator().allocate(size, alignment);
+	}
+
+	void*
+	frame_allocator::reallocate(void* block, u64 size, u64 new_size, u64 alignment)
+	{
+		return current_allocator().reallocate(block, size, new_size, alignment);
+	}
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "CommonHeaders.h"
+
+namespace havana::memory
+{
+	// Memory for arrays that are only needed for a short time, like the scratch buffers of a frame.
+	// Allocating is as cheap as moving a pointer, and nothing has to be freed. Memory that is allocated
+	// in frame F stays valid until frame F + frame_count begins, so it can be handed to the frames
+	// that are still in flight. After a few frames, the allocators have grown to the size that the
+	// frames need and frames no longer allocate from the heap.
+	// Every thread allocates from its own memory, so allocations don't need a lock.
+
+	// NOTE: must be at least the number of frames the renderer has in flight.
+	constexpr u32 frame_count{ 3 };
+
+	// Starts a new frame. Must be called once per frame, at a point where no thread uses memory
+	// that was allocated 'frame_count' frames ago.
+	void begin_frame();
+	[[nodiscard]] u64 current_frame();
+
+	[[nodiscard]] void* frame_allocate(u64 size, u64 alignment = 16);
+
+	template<typename T>
+	[[nodiscard]] T* frame_allocate_array(u64 count)
+	{
+		static_assert(std::is_trivially_destructible_v<T>, "Frame memory never calls destructors.");
+		return (T*)frame_allocate(count * sizeof(T), alignof(T));
+	}
+
+	// Allocator for vectors that only live for the current frame (see Allocators.h).
+	struct frame_allocator
+	{
+		[[nodiscard]] void* reallocate(void* block, u64 size, u64 new_size, u64 alignment);
+		void deallocate(void*, u64) {}
+	};
+
+	template<typename T>
+	using frame_vector = utl::vector<T, true, frame_allocator>;
+}
@@ -36,10 +36,30 @@ namespace havana
 		public:
 			virtual ~entity_script() = default;
 			virtual void begin_play() {};
+			// NOTE: scripts are updated in parallel on the job threads. Use game_entity::create_deferred()
+			//		 to spawn entities from here. Entities removed from here are removed once all scripts
+			//		 of the tick group are updated. Don't create or remove script components directly.
 			virtual void update(float) {};
+
+			// Scripts that keep state of their own can put it into world snapshots (see world::save_snapshot())
+			// by overriding all three functions. save() writes exactly snapshot_size() bytes. Other scripts are
+			// constructed again when a snapshot is restored, which resets their state.
+			virtual u32 snapshot_size() const { return 0; }
+			virtual void save(u8* const) const {}
+			virtual void restore(const u8* const) {}
 		protected:
 			constexpr explicit entity_script(game_entity::entity entity) : game_entity::entity{ entity.get_id() } {};
 
+			// Changes how often this script is updated. See script::init_info::tick_interval.
+			void set_tick_interval(f32 interval) const;
+
+			// A sleeping script is not updated at all until it wakes up. These take effect once
+			// the current update is done. script::wake() wakes a script up early.
+			void sleep() const; // until script::wake() is called
+			void sleep_for(f32 seconds) const;
+			void sleep_for_frames(u32 frames) const; // skips the next 'frames' updates
+			void sleep_until_input(u64 binding) const; // until the input binding changes
+
 			void set_rotation(math::v4 rotation_quaternion) const { set_rotation(this, rotation_quaternion); }
 			void set_orientation(math::v3 orientation_vector) const { set_orientation(this, orientation_vector); }
 			void set_position(math::v3 position) const { set_position(this, position); }
@@ -53,8 +73,19 @@ namespace havana
 
 		namespace detail
 		{
-			using script_ptr = std::unique_ptr<entity_script>;
-			using script_creator = script_ptr(*)(game_entity::entity entity);
+			// Tells the engine how to store and update the scripts of one class. Scripts of the same
+			// class are kept next to each other and updated in batches without a virtual call per script.
+			struct script_type
+			{
+				entity_script*	(*construct)(void* const memory, game_entity::entity entity);
+				void			(*destroy)(void* const memory);
+				void			(*update)(void* const scripts, const u8* const ticks, const f32* const dts, u32 count);
+				u32				size;
+				u32				alignment;
+				bool			has_snapshot;	// overrides entity_script::save()
+			};
+
+			using script_creator = const script_type* (*)();
 			using string_hash = std::hash<std::string>;
 
 			u8 register_script(size_t, script_creator);
@@ -64,10 +95,34 @@ namespace havana
 			script_creator get_script_creator(size_t tag);
 
 			template<class script_class>
-			script_ptr create_script(game_entity::entity entity)
+			const script_type* create_script()
 			{
-				assert(entity.is_valid());
-				return std::make_unique<script_class>(entity);
+				static_assert(std::is_base_of_v<entity_script, script_class>);
+				constexpr static script_type type
+				{
+					[](void* const memory, game_entity::entity entity) -> entity_script*
+					{
+						assert(entity.is_valid());
+						return new (memory) script_class(entity);
+					},
+					[](void* const memory)
+					{
+						((script_class*)memory)->~script_class();
+					},
+					[](void* const scripts, const u8* const ticks, const f32* const dts, u32 count)
+					{
+						script_class* const s{ (script_class*)scripts };
+						for (u32 i{ 0 }; i < count; ++i)
+						{
+							// NOTE: calling update() by its qualified name skips the virtual dispatch.
+							if (ticks[i]) s[i].script_class::update(dts[i]);
+						}
+					},
+					sizeof(script_class),
+					alignof(script_class),
+					!std::is_same_v<decltype(&script_class::save), void (entity_script::*)(u8* const) const>
+				};
+				return &type;
 			}
 			
 #ifdef USE_WITH_EDITOR
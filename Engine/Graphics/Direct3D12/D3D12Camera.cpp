@@ -5,7 +5,7 @@ namespace havana::graphics::d3d12::camera
 {
 	namespace
 	{
-		utl::free_list<d3d12_camera> cameras;
+		utl::handle_pool<d3d12_camera> cameras;
 
 		void
 		set_up_vector(d3d12_camera& camera, const void* const data, [[maybe_unused]] u32 size)
@@ -2,6 +2,7 @@
 #include "CommonHeaders.h"
 #include "Graphics/Renderer.h"
 #include "Platforms/Window.h"
+#include "Core/FrameMemory.h"
 
 #ifndef NOMINMAX
 #define NOMINMAX
@@ -18,6 +19,8 @@
 namespace havana::graphics::d3d12
 {
 	constexpr u32 frame_buffer_count{ 3 };
+	// NOTE: frame memory (see Core/FrameMemory.h) must live as long as the frames in flight.
+	static_assert(frame_buffer_count <= memory::frame_count);
 	using id3d12_device = ID3D12Device8;
 	using id3d12_graphics_command_list = ID3D12GraphicsCommandList6;
 }
@@ -3,6 +3,7 @@
 #include "Utilities/IOStream.h"
 #include "Content/ContentToEngine.h"
 #include "D3D12GPass.h"
+#include "Core/FrameMemory.h"
 
 namespace havana::graphics::d3d12::content
 {
@@ -52,12 +53,6 @@ namespace havana::graphics::d3d12::content
 		std::unordered_map<u64, id::id_type>			pso_map;
 		std::mutex										pso_mutex{};
 
-		struct
-		{
-			utl::vector<havana::content::lod_offset>	lod_offsets;
-			utl::vector<id::id_type>					geometry_ids;
-		} frame_cache;
-
 		id::id_type create_root_signature(material_type::type type, shader_flags::flags flags);
 
 		class d3d12_material_stream
@@ -667,25 +662,24 @@ namespace havana::graphics::d3d12::content
 			assert(info.render_item_ids && info.thresholds && info.render_item_count);
 			assert(d3d12_render_item_ids.empty());
 			
-			frame_cache.lod_offsets.clear();
-			frame_cache.geometry_ids.clear();
 			const u32 count{ info.render_item_count };
+			id::id_type* const geometry_ids{ memory::frame_allocate_array<id::id_type>(count) };
+			havana::content::lod_offset* const lod_offsets{ memory::frame_allocate_array<havana::content::lod_offset>(count) };
 
 			std::lock_guard lock{ render_item_mutex };
 
 			for (u32 i{ 0 }; i < count; ++i)
 			{
 				const id::id_type* const buffer{ render_item_ids[info.render_item_ids[i]].get() };
-				frame_cache.geometry_ids.emplace_back(buffer[0]);
+				geometry_ids[i] = buffer[0];
 			}
 
-			havana::content::get_lod_offsets(frame_cache.geometry_ids.data(), info.thresholds, count, frame_cache.lod_offsets);
-			assert(frame_cache.lod_offsets.size() == count);
+			havana::content::get_lod_offsets(geometry_ids, info.thresholds, count, lod_offsets);
 
 			u32 d3d12_render_item_count{ 0 };
 			for (u32 i{ 0 }; i < count; ++i)
 			{
-				d3d12_render_item_count += frame_cache.lod_offsets[i].count;
+				d3d12_render_item_count += lod_offsets[i].count;
 			}
 
 			assert(d3d12_render_item_count);
@@ -695,7 +689,7 @@ namespace havana::graphics::d3d12::content
 			for (u32 i{ 0 }; i < count; ++i)
 			{
 				const id::id_type* const item_ids{ &render_item_ids[info.render_item_ids[i]][1] };
-				const havana::content::lod_offset& lod_offset{ frame_cache.lod_offsets[i] };
+				const havana::content::lod_offset& lod_offset{ lod_offsets[i] };
 				memcpy(&d3d12_render_item_ids[item_index], &item_ids[lod_offset.offset], sizeof(id::id_type) * lod_offset.count);
 				item_index += lod_offset.count;
 				assert(item_index <= d3d12_render_item_count);
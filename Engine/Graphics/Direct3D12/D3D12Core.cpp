@@ -9,6 +9,8 @@
 #include "D3D12LightCulling.h"
 #include "D3D12Camera.h"
 #include "Shaders/SharedTypes.h"
+#include "Components/World.h"
+#include "Jobs/TaskGraph.h"
 
 extern "C" { __declspec(dllexport) extern const UINT D3D12SDKVersion = 610; }
 extern "C" { __declspec(dllexport) extern const char* D3D12SDKPath = u8".\\D3D12\\"; }
@@ -199,6 +201,36 @@ namespace havana::graphics::d3d12::core
 
 		constexpr D3D_FEATURE_LEVEL		minimum_feature_level{ D3D_FEATURE_LEVEL_11_0 };
 
+		// NOTE: CPU work of a frame that doesn't record commands. Gathering render items and
+		//		 updating light buffers don't depend on each other, so they run at the same time.
+		//		 Both read transforms, so the tasks run in the world of the thread that renders.
+		struct frame_graph_data
+		{
+			const d3d12_frame_info*			info{ nullptr };
+			world::detail::world_state*		world_state{ nullptr };
+		};
+
+		jobs::task_graph				frame_graph{};
+		frame_graph_data				graph_data{};
+
+		void
+		build_frame_graph()
+		{
+			frame_graph.clear();
+			frame_graph.add({ [](void* const data)
+				{
+					const frame_graph_data& d{ *(const frame_graph_data*)data };
+					world::scope world_scope{ d.world_state };
+					gpass::prepare_render_frame(*d.info);
+				}, &graph_data, "render items" });
+			frame_graph.add({ [](void* const data)
+				{
+					const frame_graph_data& d{ *(const frame_graph_data*)data };
+					world::scope world_scope{ d.world_state };
+					light::update_light_buffers(*d.info);
+				}, &graph_data, "light buffers" });
+		}
+
 		bool
 		failed_init()
 		{
@@ -418,6 +450,8 @@ namespace havana::graphics::d3d12::core
 			  delight::initialize())) 
 			return failed_init();
 
+		build_frame_graph();
+
 		NAME_D3D12_OBJECT(main_device, L"Main D3D Device");
 		NAME_D3D12_OBJECT(rtv_desc_heap.heap(), L"RTV Descriptor Heap");
 		NAME_D3D12_OBJECT(dsv_desc_heap.heap(), L"DSV Descriptor Heap");
@@ -440,6 +474,8 @@ namespace havana::graphics::d3d12::core
 			process_deferred_releases(i);
 		}
 
+		frame_graph.clear();
+
 		// Shutdown modules
 		delight::shutdown();
 		content::shutdown();
@@ -583,6 +619,9 @@ namespace havana::graphics::d3d12::core
 			get_d3d12_frame_info(info, cbuffer, surface, frame_idx, 16.7f)
 		};
 
+		graph_data = { &d3d12_info, world::detail::current_state() };
+		frame_graph.run();
+
 		gpass::set_size({ d3d12_info.surface_width, d3d12_info.surface_height });
 		d3dx::d3d12_resource_barrier& barriers{ resource_barriers };
 
@@ -604,7 +643,6 @@ namespace havana::graphics::d3d12::core
 		gpass::depth_prepass(cmd_list, d3d12_info);
 
 		// Geometry and Lighting Pass
-		light::update_light_buffers(d3d12_info);
 		delight::cull_lights(cmd_list, d3d12_info, barriers);
 		gpass::add_transitions_for_gpass(barriers);
 		barriers.apply(cmd_list);
@@ -8,6 +8,7 @@
 #include "Components/Entity.h"
 #include "Components/Transform.h"
 #include "D3D12LightCulling.h"
+#include "Core/FrameMemory.h"
 
 namespace havana::graphics::d3d12::gpass
 {
@@ -91,32 +92,26 @@ namespace havana::graphics::d3d12::gpass
 				d3d12_render_item_ids.clear();
 			}
 
-			CONSTEXPR void resize()
+			// NOTE: the arrays are allocated from frame memory, so they stay valid while the GPU
+			//		 still works on this frame and don't have to be freed.
+			void resize()
 			{
 				const u64 items_count{ d3d12_render_item_ids.size() };
-				const u64 new_buffer_size{ items_count * struct_size };
-				const u64 old_buffer_size{ _buffer.size() };
-				if (new_buffer_size > old_buffer_size)
-				{
-					_buffer.resize(new_buffer_size);
-				}
-
-				if (new_buffer_size != old_buffer_size)
-				{
-					entity_ids = (id::id_type*)_buffer.data();
-					submesh_gpu_ids = (id::id_type*)(&entity_ids[items_count]);
-					material_ids = (id::id_type*)(&submesh_gpu_ids[items_count]);
-					gpass_pipline_states = (ID3D12PipelineState**)(&material_ids[items_count]);
-					depth_pipline_states = (ID3D12PipelineState**)(&gpass_pipline_states[items_count]);
-					root_signatures = (ID3D12RootSignature**)(&depth_pipline_states[items_count]);
-					material_types = (material_type::type*)(&root_signatures[items_count]);
-					position_buffers = (D3D12_GPU_VIRTUAL_ADDRESS*)(&material_types[items_count]);
-					element_buffers = (D3D12_GPU_VIRTUAL_ADDRESS*)(&position_buffers[items_count]);
-					index_buffer_views = (D3D12_INDEX_BUFFER_VIEW*)(&element_buffers[items_count]);
-					primitive_topologies = (D3D12_PRIMITIVE_TOPOLOGY*)(&index_buffer_views[items_count]);
-					elements_types = (u32*)(&primitive_topologies[items_count]);
-					per_object_data = (D3D12_GPU_VIRTUAL_ADDRESS*)(&elements_types[items_count]);
-				}
+				u8* const buffer{ (u8*)memory::frame_allocate(items_count * struct_size, alignof(D3D12_GPU_VIRTUAL_ADDRESS)) };
+
+				entity_ids = (id::id_type*)buffer;
+				submesh_gpu_ids = (id::id_type*)(&entity_ids[items_count]);
+				material_ids = (id::id_type*)(&submesh_gpu_ids[items_count]);
+				gpass_pipline_states = (ID3D12PipelineState**)(&material_ids[items_count]);
+				depth_pipline_states = (ID3D12PipelineState**)(&gpass_pipline_states[items_count]);
+				root_signatures = (ID3D12RootSignature**)(&depth_pipline_states[items_count]);
+				material_types = (material_type::type*)(&root_signatures[items_count]);
+				position_buffers = (D3D12_GPU_VIRTUAL_ADDRESS*)(&material_types[items_count]);
+				element_buffers = (D3D12_GPU_VIRTUAL_ADDRESS*)(&position_buffers[items_count]);
+				index_buffer_views = (D3D12_INDEX_BUFFER_VIEW*)(&element_buffers[items_count]);
+				primitive_topologies = (D3D12_PRIMITIVE_TOPOLOGY*)(&index_buffer_views[items_count]);
+				elements_types = (u32*)(&primitive_topologies[items_count]);
+				per_object_data = (D3D12_GPU_VIRTUAL_ADDRESS*)(&elements_types[items_count]);
 			}
 
 		private:
@@ -136,8 +131,6 @@ namespace havana::graphics::d3d12::gpass
 				sizeof(u32) + // element_types
 				sizeof(D3D12_GPU_VIRTUAL_ADDRESS) // per_object_data
 			};
-
-			utl::vector<u8> _buffer;
 		} frame_cache;
 
 #undef CONSTEXPR
@@ -200,22 +193,43 @@ namespace havana::graphics::d3d12::gpass
 		{
 			const gpass_cache& cache{ frame_cache };
 			const u32 render_items_count{ (u32)cache.size() };
+
+			// Render items of the same entity are next to each other. Each entity is collected once,
+			// so all matrices can be read from the transform snapshot in one call.
+			game_entity::entity_id* const entity_ids{ memory::frame_allocate_array<game_entity::entity_id>(render_items_count) };
+			u32 entity_count{ 0 };
 			id::id_type current_entity_id{ id::invalid_id };
-			hlsl::PerObjectData* current_data_pointer{ nullptr };
+			for (u32 i{ 0 }; i < render_items_count; ++i)
+			{
+				if (current_entity_id != cache.entity_ids[i])
+				{
+					current_entity_id = cache.entity_ids[i];
+					entity_ids[entity_count++] = game_entity::entity_id{ current_entity_id };
+				}
+			}
+
+			math::m4x4* const world_matrices{ memory::frame_allocate_array<math::m4x4>(entity_count) };
+			math::m4x4* const inverse_world_matrices{ memory::frame_allocate_array<math::m4x4>(entity_count) };
+			transform::get_transform_matrices(entity_ids, entity_count, world_matrices, inverse_world_matrices);
 
+			hlsl::PerObjectData* current_data_pointer{ nullptr };
 			constant_buffer& cbuffer{ core::cbuffer() };
 
 			using namespace DirectX;
+			const XMMATRIX view_projection{ d3d12_info.camera->view_projection() };
+			u32 entity_index{ 0 };
+			current_entity_id = id::invalid_id;
 			for (u32 i{ 0 }; i < render_items_count; ++i)
 			{
 				if (current_entity_id != cache.entity_ids[i])
 				{
 					current_entity_id = cache.entity_ids[i];
 					hlsl::PerObjectData data{};
-					transform::get_transform_matrices(game_entity::entity_id{ current_entity_id }, data.World,
-					                                  data.InvWorld);
+					data.World = world_matrices[entity_index];
+					data.InvWorld = inverse_world_matrices[entity_index];
+					++entity_index;
 					XMMATRIX world{ XMLoadFloat4x4(&data.World) };
-					XMMATRIX wvp{ XMMatrixMultiply(world, d3d12_info.camera->view_projection()) };
+					XMMATRIX wvp{ XMMatrixMultiply(world, view_projection) };
 					XMStoreFloat4x4(&data.WorldViewProjection, wvp);
 
 					current_data_pointer = cbuffer.allocate<hlsl::PerObjectData>();
@@ -225,6 +239,7 @@ namespace havana::graphics::d3d12::gpass
 				assert(current_data_pointer);
 				cache.per_object_data[i] = cbuffer.gpu_address(current_data_pointer);
 			}
+			assert(entity_index == entity_count);
 		}
 
 		void
@@ -249,30 +264,6 @@ namespace havana::graphics::d3d12::gpass
 				break;
 			}
 		}
-
-		void
-		prepare_render_frame(const d3d12_frame_info& d3d12_info)
-		{
-			assert(d3d12_info.info && d3d12_info.camera);
-			assert(d3d12_info.info->render_item_ids && d3d12_info.info->render_item_count);
-			gpass_cache& cache{ frame_cache };
-			cache.clear();
-
-			using namespace content;
-			render_item::get_d3d12_render_item_ids(*d3d12_info.info, cache.d3d12_render_item_ids);
-			cache.resize();
-			const u32 items_count{ cache.size() };
-			const render_item::items_cache items_cache{ cache.items_cache() };
-			render_item::get_items(cache.d3d12_render_item_ids.data(), items_count, items_cache);
-
-			const submesh::views_cache views_cache{ cache.views_cache() };
-			submesh::get_views(items_cache.submesh_gpu_ids, items_count, views_cache);
-
-			const material::materials_cache materials_cache{ cache.materials_cache() };
-			material::get_materials(items_cache.material_ids, items_count, materials_cache);
-
-			fill_per_object_data(d3d12_info);
-		}
 	} // anonymous namespace
 
 	bool
@@ -313,10 +304,32 @@ namespace havana::graphics::d3d12::gpass
 	}
 
 	void
-	depth_prepass(id3d12_graphics_command_list* cmd_list, const d3d12_frame_info& d3d12_info)
+	prepare_render_frame(const d3d12_frame_info& d3d12_info)
 	{
-		prepare_render_frame(d3d12_info);
+		assert(d3d12_info.info && d3d12_info.camera);
+		assert(d3d12_info.info->render_item_ids && d3d12_info.info->render_item_count);
+		gpass_cache& cache{ frame_cache };
+		cache.clear();
+
+		using namespace content;
+		render_item::get_d3d12_render_item_ids(*d3d12_info.info, cache.d3d12_render_item_ids);
+		cache.resize();
+		const u32 items_count{ cache.size() };
+		const render_item::items_cache items_cache{ cache.items_cache() };
+		render_item::get_items(cache.d3d12_render_item_ids.data(), items_count, items_cache);
+
+		const submesh::views_cache views_cache{ cache.views_cache() };
+		submesh::get_views(items_cache.submesh_gpu_ids, items_count, views_cache);
+
+		const material::materials_cache materials_cache{ cache.materials_cache() };
+		material::get_materials(items_cache.material_ids, items_count, materials_cache);
+
+		fill_per_object_data(d3d12_info);
+	}
 
+	void
+	depth_prepass(id3d12_graphics_command_list* cmd_list, const d3d12_frame_info& d3d12_info)
+	{
 		const gpass_cache& cache{ frame_cache };
 		const u32 items_count{ cache.size() };
 
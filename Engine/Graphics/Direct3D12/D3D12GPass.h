@@ -37,6 +37,9 @@ namespace havana::graphics::d3d12::gpass
 
 	// NOTE: call this every frame before rendering anything in gpass
 	void set_size(math::u32v2 size);
+	// Gathers the render items of a frame and fills their per-object data. Doesn't record any commands,
+	// so it can run on any thread. Must be done before depth_prepass().
+	void prepare_render_frame(const d3d12_frame_info& d3d12_info);
 	void depth_prepass(id3d12_graphics_command_list* cmd_list, const d3d12_frame_info& d3d12_info);
 	void render(id3d12_graphics_command_list* cmd_list, const d3d12_frame_info& d3d12_info);
 
@@ -156,17 +156,26 @@ namespace havana::graphics::d3d12::light
 				const u32 count{ _enabled_light_count };
 				if (!count) return;
 
+				// Nothing was published since the last update, so there's no need to look at the lights one by one.
+				const u64 frame{ transform::get_snapshot_frame() };
+				if (frame == _transform_frame) return;
+
+				// NOTE: only the lights whose entity moved since the last snapshot we saw are updated. That can
+				//		 be several frames ago, so we use the change frames instead of the changes of the last
+				//		 frame. Entities that are newer than the snapshot have no change frame yet and are
+				//		 updated anyway.
+				u32 entity_count{ 0 };
+				const u64* const change_frames{ transform::get_change_frames(entity_count) };
 				assert(_cullable_entity_ids.size() >= count);
-				_transform_flags_cache.resize(count);
-				transform::get_updated_components_flags(_cullable_entity_ids.data(), count, _transform_flags_cache.data());
-
 				for (u32 i{ 0 }; i < count; ++i)
 				{
-					if (_transform_flags_cache[i])
+					const u32 entity_index{ (u32)id::index(_cullable_entity_ids[i]) };
+					if (entity_index >= entity_count || change_frames[entity_index] > _transform_frame)
 					{
 						update_transform(i);
 					}
 				}
+				_transform_frame = frame;
 			}
 
 			constexpr void enable(light_id id, bool is_enabled)
@@ -599,10 +608,9 @@ namespace havana::graphics::d3d12::light
 			utl::vector<game_entity::entity_id>				_cullable_entity_ids;
 			utl::vector<light_id>							_cullable_owners;
 			utl::vector<u8>									_dirty_bits;
-			
-			utl::vector<u8>									_transform_flags_cache;
 			u32												_enabled_light_count{ 0 }; // number of cullable lights
 			u8												_something_is_dirty{ 0 }; // flag set if any cullable lights have changed
+			u64												_transform_frame{ 0 }; // frame of the last transform snapshot we updated from
 
 			friend class d3d12_light_buffer;
 		};
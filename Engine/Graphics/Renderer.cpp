@@ -1,5 +1,6 @@
 #include "Renderer.h"
 #include "GraphicsPlatformInterface.h"
+#include "Components/Transform.h"
 
 namespace havana::graphics
 {
@@ -81,7 +82,11 @@ namespace havana::graphics
 	surface::render(frame_info info) const
 	{
 		assert(is_valid());
+		// NOTE: the surface reads matrices and change flags from the transform snapshot,
+		//		 so the simulation can write the next frame while this one is rendered.
+		transform::acquire_snapshot();
 		gfx.surface.render(_id, info);
+		transform::release_snapshot();
 	}
 
 	light
@@ -6,9 +6,10 @@ namespace havana::input
 	{
 		struct input_binding
 		{
-			utl::vector<input_source>	sources;
-			input_value					value{};
-			bool						is_dirty{ true };
+			// NOTE: most bindings have one or two sources, so they fit into the vector itself.
+			utl::small_vector<input_source, 2>	sources;
+			input_value							value{};
+			bool								is_dirty{ true };
 		};
 		
 		std::unordered_map<u64, input_value>	input_values;
@@ -47,7 +48,7 @@ namespace havana::input
 		const u64 binding_key{ source_binding_map[key] };
 		assert(input_bindings.count(binding_key));
 		input_binding& binding{ input_bindings[binding_key] };
-		utl::vector<input_source>& sources{ binding.sources };
+		auto& sources{ binding.sources };
 		for (u32 i{ 0 }; i < sources.size(); ++i)
 		{
 			if (sources[i].source_type == type && sources[i].code == code)
@@ -73,7 +74,7 @@ namespace havana::input
 			return;
 		}
 
-		utl::vector<input_source>& sources{ input_bindings[binding].sources };
+		auto& sources{ input_bindings[binding].sources };
 		for (const auto& source : sources)
 		{
 			assert(source.binding == binding);
@@ -142,7 +143,7 @@ namespace havana::input
 			return;
 		}
 
-		utl::vector<input_source>& sources{ input_binding.sources};
+		auto& sources{ input_binding.sources};
 		input_value sub_value{};
 		input_value result{};
 
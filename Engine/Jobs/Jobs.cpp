@@ -0,0 +1,318 @@
+#include <thread>
+#include <algorithm>
+#include <condition_variable>
+#include "Jobs.h"
+
+namespace havana::jobs
+{
+	namespace // anonymous namespace
+	{
+		struct job
+		{
+			job_desc	desc;
+			counter*	job_counter;
+		};
+
+		// A work-stealing deque. The owning thread pushes and pops jobs at the bottom
+		// (LIFO, which keeps the data of recently split work in cache) while other threads
+		// steal from the top (FIFO, which hands out the oldest and usually largest chunks).
+		// Pushing from threads other than the owner is also allowed.
+		class job_deque
+		{
+		public:
+			bool push(const job& j)
+			{
+				lock();
+				const bool has_space{ _bottom - _top < capacity };
+				if (has_space)
+				{
+					_jobs[_bottom & mask] = j;
+					++_bottom;
+				}
+				unlock();
+				return has_space;
+			}
+
+			bool pop(job& j)
+			{
+				lock();
+				const bool has_job{ _bottom != _top };
+				if (has_job)
+				{
+					--_bottom;
+					j = _jobs[_bottom & mask];
+				}
+				unlock();
+				return has_job;
+			}
+
+			bool steal(job& j)
+			{
+				// NOTE: this is a racy early out. It might miss a job that was just pushed,
+				//		 in which case the thief will find it in the next round.
+				if (_bottom == _top) return false;
+
+				lock();
+				const bool has_job{ _bottom != _top };
+				if (has_job)
+				{
+					j = _jobs[_top & mask];
+					++_top;
+				}
+				unlock();
+				return has_job;
+			}
+
+		private:
+			void lock()
+			{
+				while (_lock.test_and_set(std::memory_order_acquire))
+				{
+					std::this_thread::yield();
+				}
+			}
+
+			void unlock()
+			{
+				_lock.clear(std::memory_order_release);
+			}
+
+			constexpr static u32		capacity{ 1024 };
+			constexpr static u32		mask{ capacity - 1 };
+			static_assert((capacity & mask) == 0, "Capacity must be a power of 2.");
+
+			job							_jobs[capacity];
+			std::atomic<u32>			_bottom{ 0 };
+			std::atomic<u32>			_top{ 0 };
+			std::atomic_flag			_lock = ATOMIC_FLAG_INIT;
+		};
+
+		// NOTE: we allocate all deques at initialization, so they never move while workers are running.
+		std::unique_ptr<job_deque[]>		deques;
+		std::unique_ptr<std::thread[]>		workers;
+		u32									worker_count{ 0 };
+		std::atomic<u32>					pending_jobs{ 0 };
+		std::atomic<bool>					is_running{ false };
+		std::mutex							sleep_mutex;
+		std::condition_variable				wake_condition;
+
+		// NOTE: index 0 belongs to the main thread. Workers are numbered 1 to worker_count.
+		thread_local u32					this_thread_index{ 0 };
+		// NOTE: other threads also get index 0, so they must not execute jobs while they wait.
+		//		 Otherwise, they could use per-thread data of index 0 at the same time as the main thread.
+		thread_local bool					is_job_thread{ false };
+
+		void
+		execute(const job& j)
+		{
+			j.desc.function(j.desc.data, j.desc.begin, j.desc.end);
+			if (j.job_counter)
+			{
+				j.job_counter->value.fetch_sub(1, std::memory_order_acq_rel);
+			}
+		}
+
+		bool
+		try_get_job(u32 index, job& j)
+		{
+			if (deques[index].pop(j))
+			{
+				pending_jobs.fetch_sub(1, std::memory_order_relaxed);
+				return true;
+			}
+
+			const u32 count{ worker_count + 1 };
+			for (u32 i{ 1 }; i < count; ++i)
+			{
+				const u32 victim{ (index + i) % count };
+				if (deques[victim].steal(j))
+				{
+					pending_jobs.fetch_sub(1, std::memory_order_relaxed);
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		void
+		worker_loop(u32 index)
+		{
+			this_thread_index = index;
+			is_job_thread = true;
+
+			job j;
+			while (is_running.load(std::memory_order_acquire))
+			{
+				if (try_get_job(index, j))
+				{
+					execute(j);
+					continue;
+				}
+
+				std::unique_lock<std::mutex> lock{ sleep_mutex };
+				wake_condition.wait(lock, []
+				{
+					return pending_jobs.load(std::memory_order_relaxed) > 0 || !is_running.load(std::memory_order_relaxed);
+				});
+			}
+		}
+
+		void
+		submit(const job& j)
+		{
+			const u32 index{ this_thread_index };
+			if (deques[index].push(j))
+			{
+				pending_jobs.fetch_add(1, std::memory_order_relaxed);
+			}
+			else
+			{
+				// Our deque is full, so we run the job right away instead of failing.
+				execute(j);
+			}
+		}
+
+		void
+		wake_workers(u32 job_count)
+		{
+			{
+				// NOTE: taking the lock makes sure a worker can't miss the notification
+				//		 between checking the predicate and going to sleep.
+				std::lock_guard<std::mutex> lock{ sleep_mutex };
+			}
+
+			if (job_count > 1) wake_condition.notify_all();
+			else wake_condition.notify_one();
+		}
+	} // anonymous namespace
+
+	bool
+	initialize(u32 count)
+	{
+		assert(!is_running);
+		if (!count)
+		{
+			const u32 hardware_threads{ std::thread::hardware_concurrency() };
+			count = hardware_threads > 1 ? hardware_threads - 1 : 0;
+		}
+
+		worker_count = count;
+		this_thread_index = 0;
+		is_job_thread = true;
+		deques = std::make_unique<job_deque[]>(worker_count + 1);
+		workers = std::make_unique<std::thread[]>(worker_count);
+		is_running = true;
+
+		for (u32 i{ 0 }; i < worker_count; ++i)
+		{
+			workers[i] = std::thread{ worker_loop, i + 1 };
+		}
+
+		return true;
+	}
+
+	void
+	shutdown()
+	{
+		if (!is_running) return;
+		assert(this_thread_index == 0);
+
+		// Finish whatever is still queued before we stop the workers.
+		job j;
+		while (try_get_job(0, j))
+		{
+			execute(j);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock{ sleep_mutex };
+			is_running = false;
+		}
+		wake_condition.notify_all();
+
+		for (u32 i{ 0 }; i < worker_count; ++i)
+		{
+			workers[i].join();
+		}
+
+		assert(!pending_jobs);
+		workers.reset();
+		deques.reset();
+		worker_count = 0;
+	}
+
+	u32
+	thread_count()
+	{
+		return worker_count + 1;
+	}
+
+	u32
+	thread_index()
+	{
+		return this_thread_index;
+	}
+
+	void
+	run(const job_desc* const jobs, u32 count, counter* const c)
+	{
+		assert(jobs && count);
+		if (c) c->value.fetch_add(count, std::memory_order_relaxed);
+
+		if (!is_running)
+		{
+			// No worker threads, so we just do the work on the calling thread.
+			for (u32 i{ 0 }; i < count; ++i)
+			{
+				execute(job{ jobs[i], c });
+			}
+			return;
+		}
+
+		for (u32 i{ 0 }; i < count; ++i)
+		{
+			assert(jobs[i].function);
+			submit(job{ jobs[i], c });
+		}
+
+		wake_workers(count);
+	}
+
+	void
+	run(job_function function, void* const data, u32 count, u32 batch_size, counter* const c)
+	{
+		assert(function && count && batch_size);
+		const u32 batch_count{ (count + batch_size - 1) / batch_size };
+		if (c) c->value.fetch_add(batch_count, std::memory_order_relaxed);
+
+		for (u32 begin{ 0 }; begin < count; begin += batch_size)
+		{
+			const u32 end{ std::min(begin + batch_size, count) };
+			const job j{ job_desc{ function, data, begin, end }, c };
+
+			if (is_running) submit(j);
+			else execute(j);
+		}
+
+		if (is_running) wake_workers(batch_count);
+	}
+
+	void
+	wait(counter* const c)
+	{
+		assert(c);
+		job j;
+		while (!c->is_done())
+		{
+			if (is_running && is_job_thread && try_get_job(this_thread_index, j))
+			{
+				execute(j);
+			}
+			else
+			{
+				std::this_thread::yield();
+			}
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,78 @@
+#pragma once
+#include "CommonHeaders.h"
+
+namespace havana::jobs
+{
+	// A job runs 'function' over the index range [begin, end). 'data' is passed
+	// through untouched and must stay alive until the job has finished.
+	using job_function = void(*)(void* const data, u32 begin, u32 end);
+
+	struct job_desc
+	{
+		job_function	function{ nullptr };
+		void*			data{ nullptr };
+		u32				begin{ 0 };
+		u32				end{ 0 };
+	};
+
+	// A counter keeps track of how many jobs submitted with it are still running.
+	// It is decremented every time one of those jobs completes and wait() returns
+	// once it reaches zero. A counter can be reused after it has been waited on.
+	struct counter
+	{
+		constexpr counter() = default;
+		DISABLE_COPY_AND_MOVE(counter);
+		[[nodiscard]] bool is_done() const { return value.load(std::memory_order_acquire) == 0; }
+
+		std::atomic<u32> value{ 0 };
+	};
+
+	// Starts the worker threads. When 'worker_count' is 0, one worker per
+	// hardware thread (minus the calling thread) is created. The thread that
+	// calls initialize() becomes the main thread and has index 0.
+	bool initialize(u32 worker_count = 0);
+	void shutdown();
+
+	// Number of threads that can execute jobs, including the main thread.
+	// Always at least 1, even when the job system is not initialized.
+	u32 thread_count();
+
+	// Index of the calling thread in [0, thread_count()). Only meaningful on the
+	// main thread and on worker threads; other threads return 0.
+	u32 thread_index();
+
+	// Submits 'count' jobs. If 'c' is not null, it is incremented by 'count' and
+	// decremented again as each job completes.
+	void run(const job_desc* const jobs, u32 count, counter* const c = nullptr);
+
+	// Splits [0, count) into batches of 'batch_size' indices and submits one job per batch.
+	void run(job_function function, void* const data, u32 count, u32 batch_size, counter* const c = nullptr);
+
+	// Blocks until all jobs associated with 'c' have completed. The main thread
+	// and worker threads execute pending jobs while they wait, other threads just wait.
+	void wait(counter* const c);
+
+	// Calls 'func(begin, end)' for batches of at most 'batch_size' indices in
+	// [0, count) on all available threads and returns when every batch is done.
+	template<typename F>
+	void parallel_for(u32 count, u32 batch_size, const F& func)
+	{
+		assert(batch_size);
+		if (!count) return;
+
+		if (count <= batch_size || thread_count() == 1)
+		{
+			func(0, count);
+			return;
+		}
+
+		const job_function thunk{ [](void* const data, u32 begin, u32 end)
+			{
+				(*(const F*)data)(begin, end);
+			} };
+
+		counter c{};
+		run(thunk, (void*)std::addressof(func), count, batch_size, &c);
+		wait(&c);
+	}
+}
\ No newline at end of file
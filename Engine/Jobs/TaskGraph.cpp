@@ -0,0 +1,163 @@
+#include <algorithm>
+#include <chrono>
+#include "TaskGraph.h"
+
+namespace havana::jobs
+{
+	u32
+	task_graph::add(const task_desc& desc, const u32* const dependencies, u32 dependency_count)
+	{
+		assert(desc.function);
+		assert(!dependency_count || dependencies);
+		const u32 index{ (u32)_tasks.size() };
+		_tasks.emplace_back(task{ desc, (u32)_dependencies.size(), dependency_count, 0, 0, 0.f });
+
+		for (u32 i{ 0 }; i < dependency_count; ++i)
+		{
+			assert(dependencies[i] < index);
+			_dependencies.emplace_back(dependencies[i]);
+		}
+
+		_is_built = false;
+		return index;
+	}
+
+	void
+	task_graph::run()
+	{
+		const u32 count{ size() };
+		if (!count) return;
+		if (!_is_built) build_successors();
+
+		assert(_counter.is_done());
+		for (u32 i{ 0 }; i < count; ++i)
+		{
+			_remaining[i].store(_tasks[i].dependency_count, std::memory_order_relaxed);
+		}
+		// NOTE: every task decrements the counter when it's done, so it reaches zero after the last one.
+		_counter.value.store(count, std::memory_order_release);
+
+		jobs::run(_roots.data(), (u32)_roots.size());
+		wait(&_counter);
+	}
+
+	void
+	task_graph::clear()
+	{
+		assert(_counter.is_done());
+		_tasks.clear();
+		_dependencies.clear();
+		_successors.clear();
+		_roots.clear();
+		_remaining.reset();
+		_is_built = false;
+	}
+
+	f32
+	task_graph::critical_path(utl::vector<u32>& tasks) const
+	{
+		tasks.clear();
+		const u32 count{ size() };
+		if (!count) return 0.f;
+
+		// NOTE: tasks only depend on tasks that were added before them, so
+		//		 the order of the tasks is already a topological order.
+		utl::vector<f32> finish_times(count);
+		utl::vector<u32> previous(count);
+		u32 last{ 0 };
+		for (u32 i{ 0 }; i < count; ++i)
+		{
+			const task& t{ _tasks[i] };
+			f32 start{ 0.f };
+			previous[i] = u32_invalid_id;
+			for (u32 d{ 0 }; d < t.dependency_count; ++d)
+			{
+				const u32 dependency{ _dependencies[t.first_dependency + d] };
+				if (finish_times[dependency] > start)
+				{
+					start = finish_times[dependency];
+					previous[i] = dependency;
+				}
+			}
+
+			finish_times[i] = start + t.duration;
+			if (finish_times[i] > finish_times[last]) last = i;
+		}
+
+		for (u32 i{ last }; i != u32_invalid_id; i = previous[i])
+		{
+			tasks.emplace_back(i);
+		}
+		std::reverse(tasks.begin(), tasks.end());
+		return finish_times[last];
+	}
+
+	void
+	task_graph::build_successors()
+	{
+		const u32 count{ size() };
+		for (u32 i{ 0 }; i < count; ++i) _tasks[i].successor_count = 0;
+		for (u32 i{ 0 }; i < _dependencies.size(); ++i) ++_tasks[_dependencies[i]].successor_count;
+
+		u32 offset{ 0 };
+		for (u32 i{ 0 }; i < count; ++i)
+		{
+			_tasks[i].first_successor = offset;
+			offset += _tasks[i].successor_count;
+			_tasks[i].successor_count = 0;
+		}
+
+		_successors.resize(offset);
+		_roots.clear();
+		for (u32 i{ 0 }; i < count; ++i)
+		{
+			const task& t{ _tasks[i] };
+			for (u32 d{ 0 }; d < t.dependency_count; ++d)
+			{
+				task& dependency{ _tasks[_dependencies[t.first_dependency + d]] };
+				_successors[dependency.first_successor + dependency.successor_count] = i;
+				++dependency.successor_count;
+			}
+
+			if (!t.dependency_count) _roots.emplace_back(job_desc{ execute, this, i, i + 1 });
+		}
+
+		_remaining = std::make_unique<std::atomic<u32>[]>(count);
+		_is_built = true;
+	}
+
+	void
+	task_graph::execute(void* const data, u32 begin, u32 end)
+	{
+		assert(data && end == begin + 1);
+		task_graph& graph{ *(task_graph*)data };
+		u32 index{ begin };
+
+		while (index != u32_invalid_id)
+		{
+			task& t{ graph._tasks[index] };
+			const auto start{ std::chrono::high_resolution_clock::now() };
+			t.desc.function(t.desc.data);
+			t.duration = std::chrono::duration<f32>(std::chrono::high_resolution_clock::now() - start).count();
+
+			// Submit the successors that only waited for this task. We keep one of them
+			// and run it right away on this thread instead of going through a queue.
+			u32 next{ u32_invalid_id };
+			for (u32 i{ 0 }; i < t.successor_count; ++i)
+			{
+				const u32 successor{ graph._successors[t.first_successor + i] };
+				if (graph._remaining[successor].fetch_sub(1, std::memory_order_acq_rel) != 1) continue;
+
+				if (next != u32_invalid_id)
+				{
+					const job_desc job{ execute, data, next, next + 1 };
+					jobs::run(&job, 1);
+				}
+				next = successor;
+			}
+
+			graph._counter.value.fetch_sub(1, std::memory_order_acq_rel);
+			index = next;
+		}
+	}
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <initializer_list>
+#include "Jobs.h"
+
+namespace havana::jobs
+{
+	// A task runs once per run of its graph. 'data' is passed through untouched.
+	using task_function = void(*)(void* const data);
+
+	struct task_desc
+	{
+		task_function	function{ nullptr };
+		void*			data{ nullptr };
+		const char*		name{ nullptr };	// only used for profiling
+	};
+
+	// The work of a frame as a graph of tasks that depend on each other. A task is submitted to the job
+	// system as soon as all of its dependencies are done, so tasks that don't depend on each other run
+	// at the same time without any explicit ordering. A graph is built once and then run every frame.
+	// It keeps the time each task took in the last run, which shows the critical path of the frame.
+	class task_graph
+	{
+	public:
+		task_graph() = default;
+		DISABLE_COPY_AND_MOVE(task_graph);
+
+		// Adds a task that starts after all tasks in 'dependencies' are done. Tasks can only depend on tasks
+		// that were added before them, which means a graph can't have cycles. Returns the index of the task.
+		u32 add(const task_desc& desc, const u32* const dependencies = nullptr, u32 dependency_count = 0);
+		u32 add(const task_desc& desc, std::initializer_list<u32> dependencies)
+		{
+			return add(desc, dependencies.begin(), (u32)dependencies.size());
+		}
+
+		// Runs all tasks and returns when the last one is done. The calling thread executes tasks
+		// while it waits. A graph must not be changed or run again while it's running.
+		void run();
+		void clear();
+
+		[[nodiscard]] u32 size() const { return (u32)_tasks.size(); }
+		[[nodiscard]] const char* name(u32 task) const { return _tasks[task].desc.name; }
+		// Time in seconds that a task took in the last run.
+		[[nodiscard]] f32 duration(u32 task) const { return _tasks[task].duration; }
+		// The chain of dependent tasks that took the longest in the last run, in the order they ran.
+		// A run can't be faster than the sum of their durations, which is returned.
+		f32 critical_path(utl::vector<u32>& tasks) const;
+
+	private:
+		struct task
+		{
+			task_desc			desc;
+			u32					first_dependency;
+			u32					dependency_count;
+			u32					first_successor;
+			u32					successor_count;
+			f32					duration;
+		};
+
+		void build_successors();
+		static void execute(void* const data, u32 begin, u32 end);
+
+		utl::vector<task>							_tasks;
+		utl::vector<u32>							_dependencies;
+		utl::vector<u32>							_successors;
+		utl::vector<job_desc>						_roots;
+		// NOTE: number of dependencies of each task that haven't finished yet in the current run.
+		std::unique_ptr<std::atomic<u32>[]>			_remaining;
+		counter										_counter;
+		bool										_is_built{ false };
+	};
+}
@@ -0,0 +1,345 @@
+#pragma once
+#include "CommonHeaders.h"
+
+namespace havana::utl
+{
+	// Allocators for utl::vector. Every allocator has these two functions:
+	//
+	//	void* reallocate(void* block, u64 size, u64 new_size, u64 alignment);
+	//	void deallocate(void* block, u64 size);
+	//
+	// reallocate() works like realloc(): 'block' is null when 'size' is 0 and the first 'size' bytes
+	// are kept when the block moves. heap_allocator has no state and is the default of utl::vector.
+	// The other allocators own their memory. Vectors keep a pointer to them, so they must outlive
+	// every vector that uses them. None of them is thread-safe.
+
+	struct heap_allocator
+	{
+		[[nodiscard]] void* reallocate(void* block, u64, u64 new_size, u64)
+		{
+			// NOTE: realloc() aligns to alignof(max_align_t), which is enough for all types we put in vectors.
+			return realloc(block, new_size);
+		}
+
+		void deallocate(void* block, u64) { free(block); }
+	};
+
+	namespace detail
+	{
+		[[nodiscard]] constexpr u8*
+		align_pointer(u8* const p, u64 alignment)
+		{
+			assert(alignment && !(alignment & (alignment - 1)));
+			return (u8*)(((uintptr_t)p + (alignment - 1)) & ~(uintptr_t)(alignment - 1));
+		}
+
+		// Containers keep a pointer to allocators that have state. Allocators without state
+		// are created when they're used, so they don't make containers any bigger.
+		template<typename A, bool = std::is_empty_v<A>>
+		class allocator_ref
+		{
+		public:
+			constexpr allocator_ref() = default;
+			constexpr explicit allocator_ref(A&) {}
+
+		protected:
+			[[nodiscard]] constexpr A get_allocator() const { return A{}; }
+			[[nodiscard]] constexpr bool has_allocator() const { return true; }
+			constexpr void set_allocator(A&) {}
+		};
+
+		template<typename A>
+		class allocator_ref<A, false>
+		{
+		public:
+			constexpr allocator_ref() = default;
+			constexpr explicit allocator_ref(A& allocator) : _allocator{ std::addressof(allocator) } {}
+
+		protected:
+			[[nodiscard]] constexpr A& get_allocator() const
+			{
+				// NOTE: containers with allocators that have state must get one before they allocate memory.
+				assert(_allocator);
+				return *_allocator;
+			}
+
+			[[nodiscard]] constexpr bool has_allocator() const { return _allocator != nullptr; }
+			constexpr void set_allocator(A& allocator) { _allocator = std::addressof(allocator); }
+
+		private:
+			A*	_allocator{ nullptr };
+		};
+	} // detail namespace
+
+	// Hands out memory by moving a pointer forward. Single allocations aren't freed, reset() frees all of
+	// them at once. The last allocation can grow in place, so growing one vector at a time doesn't waste
+	// memory. When a block is full, a new one is allocated that is at least twice as big. reset() only
+	// keeps the last block, so after a few rounds everything fits into one block.
+	class linear_allocator
+	{
+	public:
+		explicit linear_allocator(u64 block_size = 64 * 1024) : _block_size{ block_size } { assert(block_size); }
+		~linear_allocator() { release(); }
+		DISABLE_COPY_AND_MOVE(linear_allocator);
+
+		[[nodiscard]] void* allocate(u64 size, u64 alignment = 16)
+		{
+			u8* p{ _top ? detail::align_pointer(_top, alignment) : nullptr };
+			if (!p || p + size > _end)
+			{
+				add_block(size + alignment);
+				p = detail::align_pointer(_top, alignment);
+			}
+
+			assert(p + size <= _end);
+			_last = p;
+			_top = p + size;
+			return p;
+		}
+
+		[[nodiscard]] void* reallocate(void* block, u64 size, u64 new_size, u64 alignment)
+		{
+			if (block && block == _last && (u8*)block + new_size <= _end)
+			{
+				_top = (u8*)block + new_size;
+				return block;
+			}
+
+			void* const new_block{ allocate(new_size, alignment) };
+			if (block) memcpy(new_block, block, size < new_size ? size : new_size);
+			return new_block;
+		}
+
+		void deallocate(void*, u64) {}
+
+		// Frees all allocations. Vectors that use this allocator must be empty or destroyed.
+		void reset()
+		{
+			if (!_block) return;
+			while (_block->previous)
+			{
+				block_header* const previous{ _block->previous };
+				_block->previous = previous->previous;
+				free(previous);
+			}
+
+			_top = (u8*)(_block + 1);
+			_last = nullptr;
+		}
+
+		// Frees all allocations and all memory.
+		void release()
+		{
+			reset();
+			free(_block);
+			_block = nullptr;
+			_top = _end = nullptr;
+		}
+
+	private:
+		struct block_header
+		{
+			block_header*		previous;
+			u64					size;
+		};
+
+		void add_block(u64 min_size)
+		{
+			u64 size{ _block_size > min_size ? _block_size : min_size };
+			if (_block && _block->size * 2 > size) size = _block->size * 2;
+			block_header* const block{ (block_header*)malloc(sizeof(block_header) + size) };
+			assert(block);
+			block->previous = _block;
+			block->size = size;
+			_block = block;
+			_top = (u8*)(block + 1);
+			_end = _top + size;
+			_last = nullptr;
+		}
+
+		block_header*			_block{ nullptr };
+		u8*						_top{ nullptr };
+		u8*						_end{ nullptr };
+		u8*						_last{ nullptr };
+		const u64				_block_size;
+	};
+
+	// A fixed amount of memory that is used like a stack. Allocations that are freed in the reverse order
+	// of allocating them give their memory back right away, other allocations are freed by going back
+	// to a marker. The top allocation can grow in place.
+	class stack_allocator
+	{
+	public:
+		using marker = u64;
+
+		explicit stack_allocator(u64 capacity)
+			: _memory{ (u8*)malloc(capacity) }, _capacity{ capacity }
+		{
+			assert(_memory);
+		}
+
+		~stack_allocator()
+		{
+			assert(!_top);
+			free(_memory);
+		}
+
+		DISABLE_COPY_AND_MOVE(stack_allocator);
+
+		[[nodiscard]] void* allocate(u64 size, u64 alignment = 16)
+		{
+			u8* const p{ detail::align_pointer(_memory + _top, alignment) };
+			// NOTE: the stack doesn't grow. Increase its capacity if this fails.
+			assert(p + size <= _memory + _capacity);
+			if (p + size > _memory + _capacity) return nullptr;
+
+			_top = (p - _memory) + size;
+			return p;
+		}
+
+		[[nodiscard]] void* reallocate(void* block, u64 size, u64 new_size, u64 alignment)
+		{
+			if (block && is_top(block, size) && (u8*)block + new_size <= _memory + _capacity)
+			{
+				_top = ((u8*)block - _memory) + new_size;
+				return block;
+			}
+
+			void* const new_block{ allocate(new_size, alignment) };
+			if (block && new_block) memcpy(new_block, block, size < new_size ? size : new_size);
+			return new_block;
+		}
+
+		void deallocate(void* block, u64 size)
+		{
+			if (block && is_top(block, size)) _top = (u8*)block - _memory;
+		}
+
+		[[nodiscard]] marker get_marker() const { return _top; }
+
+		// Frees everything that was allocated after 'm' was taken.
+		void free_to_marker(marker m)
+		{
+			assert(m <= _top);
+			_top = m;
+		}
+
+		[[nodiscard]] u64 size() const { return _top; }
+		[[nodiscard]] u64 capacity() const { return _capacity; }
+
+	private:
+		[[nodiscard]] bool is_top(void* block, u64 size) const
+		{
+			return (u8*)block + size == _memory + _top;
+		}
+
+		u8* const				_memory;
+		const u64				_capacity;
+		u64						_top{ 0 };
+	};
+
+	// Blocks of one fixed size that are allocated in pages and reused after they're freed. Vectors can
+	// grow up to the block size without allocating, so it's a good fit for many small vectors with
+	// a known maximum size. Reserve that size when a vector is created, because vectors grow by 50%
+	// and could otherwise ask for more than a block. Larger requests are taken from the heap; the
+	// size that is passed to deallocate() tells which of the two a block came from.
+	class pool_allocator
+	{
+	public:
+		explicit pool_allocator(u64 block_size, u32 blocks_per_page = 64)
+			: _block_size{ block_size > 16 ? (block_size + 15) & ~(u64)15 : 16 }, _blocks_per_page{ blocks_per_page }
+		{
+			assert(block_size && blocks_per_page);
+		}
+
+		~pool_allocator()
+		{
+			while (_pages)
+			{
+				page* const next{ _pages->next };
+				free(_pages);
+				_pages = next;
+			}
+		}
+
+		DISABLE_COPY_AND_MOVE(pool_allocator);
+
+		[[nodiscard]] void* allocate(u64 size, u64 alignment = 16)
+		{
+			// NOTE: malloc() aligns to 16 bytes on x64, as do the blocks.
+			assert(alignment <= 16);
+			if (size > _block_size) return malloc(size);
+			if (!_free_blocks) add_page();
+
+			free_block* const block{ _free_blocks };
+			_free_blocks = block->next;
+			return block;
+		}
+
+		[[nodiscard]] void* reallocate(void* block, u64 size, u64 new_size, u64 alignment)
+		{
+			if (!block) return allocate(new_size, alignment);
+
+			// NOTE: every block has the maximum size, so there's nothing to move while the size fits into one.
+			const bool is_heap_block{ size > _block_size };
+			if (!is_heap_block && new_size <= _block_size) return block;
+			if (is_heap_block && new_size > _block_size) return realloc(block, new_size);
+
+			void* const new_block{ allocate(new_size, alignment) };
+			if (new_block)
+			{
+				memcpy(new_block, block, size < new_size ? size : new_size);
+				deallocate(block, size);
+			}
+			return new_block;
+		}
+
+		void deallocate(void* block, u64 size)
+		{
+			if (!block) return;
+			if (size > _block_size)
+			{
+				free(block);
+				return;
+			}
+
+			free_block* const b{ (free_block*)block };
+			b->next = _free_blocks;
+			_free_blocks = b;
+		}
+
+		[[nodiscard]] u64 block_size() const { return _block_size; }
+
+	private:
+		struct free_block
+		{
+			free_block*			next;
+		};
+
+		struct alignas(16) page
+		{
+			page*				next;
+		};
+
+		void add_page()
+		{
+			page* const p{ (page*)malloc(sizeof(page) + _block_size * _blocks_per_page) };
+			assert(p);
+			p->next = _pages;
+			_pages = p;
+
+			u8* const blocks{ (u8*)(p + 1) };
+			for (u32 i{ _blocks_per_page }; i > 0; --i)
+			{
+				free_block* const b{ (free_block*)(blocks + (i - 1) * _block_size) };
+				b->next = _free_blocks;
+				_free_blocks = b;
+			}
+		}
+
+		page*					_pages{ nullptr };
+		free_block*				_free_blocks{ nullptr };
+		const u64				_block_size;
+		const u32				_blocks_per_page;
+	};
+}
@@ -0,0 +1,264 @@
+#pragma once
+#include "CommonHeaders.h"
+#include "Allocators.h"
+
+namespace havana::utl
+{
+	// A double-ended queue similar to std::deque with basic functionality. Items are stored in one
+	// ring buffer with a power-of-two capacity, so pushing and popping at either end only moves an
+	// index and there are no per-block allocations like in std::deque. The buffer doubles when it's
+	// full. Like utl::vector, items are moved with memcpy and the template argument specifies whether
+	// their destructor is called when they're removed.
+	template<typename T, bool destruct = true, typename allocator = heap_allocator>
+	class deque : private detail::allocator_ref<allocator>
+	{
+		using allocator_base = detail::allocator_ref<allocator>;
+
+	public:
+		template<typename D, typename U>
+		class iterator_base
+		{
+		public:
+			constexpr iterator_base(D* d, u64 index) : _deque{ d }, _index{ index } {}
+			[[nodiscard]] constexpr U& operator*() const { return (*_deque)[_index]; }
+			[[nodiscard]] constexpr U* operator->() const { return std::addressof((*_deque)[_index]); }
+			constexpr iterator_base& operator++() { ++_index; return *this; }
+			[[nodiscard]] constexpr bool operator==(const iterator_base& o) const { return _index == o._index; }
+			[[nodiscard]] constexpr bool operator!=(const iterator_base& o) const { return _index != o._index; }
+
+		private:
+			D*		_deque;
+			u64		_index;
+		};
+
+		using iterator = iterator_base<deque, T>;
+		using const_iterator = iterator_base<const deque, const T>;
+
+		// Default constructor, doesn't allocate memory.
+		deque() = default;
+
+		// Constructor that allocates memory for at least 'capacity' items.
+		constexpr explicit deque(u64 capacity) { reserve(capacity); }
+
+		// Constructors that take memory from 'a'. It must outlive the deque.
+		constexpr explicit deque(allocator& a) : allocator_base{ a } {}
+		constexpr explicit deque(u64 capacity, allocator& a) : allocator_base{ a } { reserve(capacity); }
+
+		// Destructs the deque and its items as specified in the template argument
+		~deque() { destroy(); }
+
+		// Copy-constructor. Constructs by copying another deque. The items
+		// in the copied deque must be copyable. Uses the same allocator.
+		constexpr deque(const deque& o) : allocator_base{ o } { *this = o; }
+
+		// Move-constructor. Constructs by moving another deque.
+		// The original deque will be empty after move.
+		constexpr deque(deque&& o) : allocator_base{ o }, _data{ o._data }, _capacity{ o._capacity }, _head{ o._head }, _size{ o._size } { o.reset(); }
+
+		// Copy-assignment operator. Clears this deque and copies items
+		// from another deque. The items must be copyable.
+		constexpr deque& operator=(const deque& o)
+		{
+			assert(this != std::addressof(o));
+			if (this != std::addressof(o))
+			{
+				if (!allocator_base::has_allocator()) allocator_base::operator=(o);
+				clear();
+				reserve(o._size);
+				for (const auto& item : o)
+				{
+					emplace_back(item);
+				}
+				assert(_size == o._size);
+			}
+
+			return *this;
+		}
+
+		// Move-assignment operator. Frees all resources in this deque and
+		// moves the other deque into this one.
+		constexpr deque& operator=(deque&& o)
+		{
+			assert(this != std::addressof(o));
+			if (this != std::addressof(o))
+			{
+				destroy();
+				move(o);
+			}
+
+			return *this;
+		}
+
+		// Inserts an item at the end of the deque by copying 'value'
+		constexpr void push_back(const T& value) { emplace_back(value); }
+		// Inserts an item at the end of the deque by moving 'value'
+		constexpr void push_back(T&& value) { emplace_back(std::move(value)); }
+		// Inserts an item at the start of the deque by copying 'value'
+		constexpr void push_front(const T& value) { emplace_front(value); }
+		// Inserts an item at the start of the deque by moving 'value'
+		constexpr void push_front(T&& value) { emplace_front(std::move(value)); }
+
+		// Copy-constructs or move-constructs an item at the end of the deque
+		template<typename... params>
+		constexpr decltype(auto) emplace_back(params&&... p)
+		{
+			if (_size == _capacity) grow();
+			T* const item{ new (std::addressof(_data[slot(_size)])) T(std::forward<params>(p)...) };
+			++_size;
+			return *item;
+		}
+
+		// Copy-constructs or move-constructs an item at the start of the deque
+		template<typename... params>
+		constexpr decltype(auto) emplace_front(params&&... p)
+		{
+			if (_size == _capacity) grow();
+			const u64 head{ (_head - 1) & (_capacity - 1) };
+			T* const item{ new (std::addressof(_data[head])) T(std::forward<params>(p)...) };
+			_head = head;
+			++_size;
+			return *item;
+		}
+
+		// Removes the last item
+		constexpr void pop_back()
+		{
+			assert(_size);
+			--_size;
+			if constexpr (destruct) _data[slot(_size)].~T();
+		}
+
+		// Removes the first item
+		constexpr void pop_front()
+		{
+			assert(_size);
+			if constexpr (destruct) _data[_head].~T();
+			_head = (_head + 1) & (_capacity - 1);
+			--_size;
+		}
+
+		// Allocates memory to contain at least the specified number of items.
+		constexpr void reserve(u64 new_capacity)
+		{
+			if (new_capacity <= _capacity) return;
+
+			u64 capacity{ _capacity ? _capacity : 8 };
+			while (capacity < new_capacity) capacity <<= 1;
+
+			// NOTE: like realloc(), the allocator copies the data in the buffer if a new region of memory is allocated
+			void* new_buffer{ allocator_base::get_allocator().reallocate(_data, _capacity * sizeof(T), capacity * sizeof(T), alignof(T)) };
+			assert(new_buffer);
+			if (!new_buffer) return;
+
+			_data = static_cast<T*>(new_buffer);
+			// The items that wrapped around to the start of the old buffer are moved behind its end.
+			// There's enough room for them, because the capacity at least doubled.
+			if (_head + _size > _capacity)
+			{
+				memcpy(std::addressof(_data[_capacity]), std::addressof(_data[0]), (_head + _size - _capacity) * sizeof(T));
+			}
+			_capacity = capacity;
+		}
+
+		// Clears deque and destructs items as specified in the template argument
+		constexpr void clear()
+		{
+			if constexpr (destruct)
+			{
+				for (u64 i{ 0 }; i < _size; ++i)
+				{
+					_data[slot(i)].~T();
+				}
+			}
+
+			_head = 0;
+			_size = 0;
+		}
+
+		// Swaps two deques, including their allocators
+		constexpr void swap(deque& o)
+		{
+			if (this != std::addressof(o))
+			{
+				auto temp(std::move(o));
+				o.move(*this);
+				move(temp);
+			}
+		}
+
+		// Returns true if empty
+		[[nodiscard]] constexpr bool empty() const { return _size == 0; }
+		// Returns number of items in the deque
+		[[nodiscard]] constexpr u64 size() const { return _size; }
+		// Returns the capacity of the deque, which is always a power of two
+		[[nodiscard]] constexpr u64 capacity() const { return _capacity; }
+
+		// Indexing operator - returns a reference to the item at the specified index, counted from the front.
+		[[nodiscard]] constexpr T& operator[](u64 index)
+		{
+			assert(_data && index < _size);
+			return _data[slot(index)];
+		}
+
+		// Indexing operator - returns a constant reference to the item at the specified index, counted from the front.
+		[[nodiscard]] constexpr const T& operator[](u64 index) const
+		{
+			assert(_data && index < _size);
+			return _data[slot(index)];
+		}
+
+		// Returns a reference to the first item - the deque must not be empty
+		[[nodiscard]] constexpr T& front() { return (*this)[0]; }
+		[[nodiscard]] constexpr const T& front() const { return (*this)[0]; }
+		// Returns a reference to the last item - the deque must not be empty
+		[[nodiscard]] constexpr T& back() { return (*this)[_size - 1]; }
+		[[nodiscard]] constexpr const T& back() const { return (*this)[_size - 1]; }
+
+		[[nodiscard]] constexpr iterator begin() { return iterator{ this, 0 }; }
+		[[nodiscard]] constexpr const_iterator begin() const { return const_iterator{ this, 0 }; }
+		[[nodiscard]] constexpr iterator end() { return iterator{ this, _size }; }
+		[[nodiscard]] constexpr const_iterator end() const { return const_iterator{ this, _size }; }
+
+	private:
+		// Position in the buffer of the item at 'index'.
+		[[nodiscard]] constexpr u64 slot(u64 index) const
+		{
+			return (_head + index) & (_capacity - 1);
+		}
+
+		constexpr void grow()
+		{
+			reserve(_capacity + 1);
+		}
+
+		constexpr void move(deque& o)
+		{
+			allocator_base::operator=(o);
+			_data = o._data;
+			_capacity = o._capacity;
+			_head = o._head;
+			_size = o._size;
+			o.reset();
+		}
+
+		constexpr void reset()
+		{
+			_data = nullptr;
+			_capacity = 0;
+			_head = 0;
+			_size = 0;
+		}
+
+		constexpr void destroy()
+		{
+			clear();
+			if (_data) allocator_base::get_allocator().deallocate(_data, _capacity * sizeof(T));
+			reset();
+		}
+
+		T*		_data{ nullptr };
+		u64		_capacity{ 0 };
+		u64		_head{ 0 };
+		u64		_size{ 0 };
+	};
+}
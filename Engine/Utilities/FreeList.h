@@ -2,25 +2,104 @@
 
 #include "CommonHeaders.h"
 
+#ifdef _WIN64
+#include <intrin.h>
+#endif
+
 namespace havana::utl
 {
-#if USE_STL_VECTOR
-	#pragma message("WARNING: using utl::free_list with std::vector results in duplicate calls to class constructor!")
+	namespace detail
+	{
+		// Index of the lowest bit that is set. 'bits' must not be zero.
+		[[nodiscard]] inline u32
+		first_set_bit(u64 bits)
+		{
+			assert(bits);
+#ifdef _WIN64
+			unsigned long index;
+			_BitScanForward64(&index, bits);
+			return (u32)index;
+#else
+			return (u32)__builtin_ctzll(bits);
 #endif
+		}
+	} // detail namespace
 
+	// Items that are addressed by an index which stays the same as long as the item is alive.
+	// Items are stored in chunks of 'chunk_size' items that never move, so references to items stay
+	// valid when the list grows. Every chunk has a word of occupancy bits, which is used to check
+	// ids and to iterate over the live items without looking at removed slots. Removed slots are
+	// reused before the list grows, their memory holds the index of the next free slot.
 	template<typename T>
 	class free_list
 	{
 		static_assert(sizeof(T) >= sizeof(u32));
+		constexpr static u32 chunk_shift{ 6 };
+		constexpr static u32 chunk_size{ 1u << chunk_shift }; // one occupancy word per chunk
+
+		template<typename L, typename U>
+		class iterator_base
+		{
+		public:
+			constexpr iterator_base(L* list, u32 chunk) : _list{ list }, _chunk{ chunk }
+			{
+				find_next();
+			}
+
+			[[nodiscard]] constexpr U& operator*() const { return _list->item(id()); }
+			[[nodiscard]] constexpr U* operator->() const { return std::addressof(_list->item(id())); }
+			// Id of the item the iterator points to.
+			[[nodiscard]] u32 id() const { return (_chunk << chunk_shift) + detail::first_set_bit(_bits); }
+
+			constexpr iterator_base& operator++()
+			{
+				_bits &= _bits - 1;
+				if (!_bits)
+				{
+					++_chunk;
+					find_next();
+				}
+				return *this;
+			}
+
+			[[nodiscard]] constexpr bool operator==(const iterator_base& o) const { return _chunk == o._chunk && _bits == o._bits; }
+			[[nodiscard]] constexpr bool operator!=(const iterator_base& o) const { return !(*this == o); }
+
+		private:
+			// Skips chunks without live items.
+			constexpr void find_next()
+			{
+				const u32 chunk_count{ (u32)_list->_occupied.size() };
+				while (_chunk < chunk_count && !_list->_occupied[_chunk]) ++_chunk;
+				_bits = _chunk < chunk_count ? _list->_occupied[_chunk] : 0;
+			}
+
+			L*		_list;
+			u32		_chunk;
+			u64		_bits{ 0 };
+		};
+
 	public:
+		using iterator = iterator_base<free_list, T>;
+		using const_iterator = iterator_base<const free_list, const T>;
+
 		free_list() = default;
-		explicit free_list(u32 count) { _array.reserve(count); }
-		~free_list() 
-		{ 
+		explicit free_list(u32 count) { reserve(count); }
+		DISABLE_COPY(free_list);
+		free_list(free_list&& o) { swap(o); }
+		free_list& operator=(free_list&& o)
+		{
+			assert(this != std::addressof(o));
+			free_list temp{ std::move(o) };
+			swap(temp);
+			return *this;
+		}
+
+		// NOTE: all items should be removed by now. Like before, items that are still alive aren't destructed.
+		~free_list()
+		{
 			assert(!_size);
-#if USE_STL_VECTOR
-			memset(_array.data(), 0, _array.size() * sizeof(T));
-#endif
+			for (u32 i{ 0 }; i < _chunks.size(); ++i) free_chunk(_chunks[i]);
 		}
 
 		template<class... params>
@@ -29,39 +108,78 @@ namespace havana::utl
 			u32 id{ u32_invalid_id };
 			if (_next_free_index == u32_invalid_id)
 			{
-				id = (u32)_array.size();
-				_array.emplace_back(std::forward<params>(p)...);
+				id = _end;
+				if ((id >> chunk_shift) == _chunks.size()) add_chunk();
+				++_end;
 			}
 			else
 			{
 				id = _next_free_index;
-				assert(id < _array.size() && already_removed(id));
-				_next_free_index = *(const u32* const)std::addressof(_array[id]);
-				new (std::addressof(_array[id])) T(std::forward<params>(p)...);
+				assert(id < _end && !is_alive(id));
+				_next_free_index = *(const u32* const)slot(id);
 			}
+
+			new (slot(id)) T(std::forward<params>(p)...);
+			_occupied[id >> chunk_shift] |= bit(id);
 			++_size;
 			return id;
 		}
 
 		constexpr void remove(u32 id)
 		{
-			assert(id < _array.size() && !already_removed(id));
-			T& item{ _array[id] };
-			item.~T();
-			DEBUG_OP(memset(std::addressof(_array[id]), 0xcc, sizeof(T)));
-			*(u32* const)std::addressof(_array[id]) = _next_free_index;
+			assert(is_alive(id));
+			item(id).~T();
+			DEBUG_OP(memset(slot(id), 0xcc, sizeof(T)));
+			*(u32* const)slot(id) = _next_free_index;
+			_occupied[id >> chunk_shift] &= ~bit(id);
 			_next_free_index = id;
 			--_size;
 		}
 
+		// Makes sure that the list has room for 'count' items without allocating more chunks.
+		void reserve(u32 count)
+		{
+			while (((u32)_chunks.size() << chunk_shift) < count) add_chunk();
+		}
+
+		// Frees the chunks at the end that have no live items and rebuilds the free list in the order of
+		// the ids. That way, add() fills the lowest free slots first and live items gather in the first
+		// chunks, so the next shrink() can free more. Ids of live items don't change.
+		void shrink()
+		{
+			u32 chunk_count{ (u32)_chunks.size() };
+			while (chunk_count && !_occupied[chunk_count - 1])
+			{
+				--chunk_count;
+				free_chunk(_chunks[chunk_count]);
+			}
+			_chunks.resize(chunk_count);
+			_occupied.resize(chunk_count);
+
+			_end = chunk_count << chunk_shift;
+			_next_free_index = u32_invalid_id;
+			for (u32 id{ _end }; id > 0; --id)
+			{
+				if (is_alive(id - 1)) continue;
+				*(u32* const)slot(id - 1) = _next_free_index;
+				_next_free_index = id - 1;
+			}
+		}
+
+		[[nodiscard]] constexpr bool is_alive(u32 id) const
+		{
+			return id < _end && (_occupied[id >> chunk_shift] & bit(id)) != 0;
+		}
+
 		constexpr u32 size() const
 		{
 			return _size;
 		}
 
+		// Every id that was handed out is smaller than this.
 		constexpr u32 capacity() const
 		{
-			return _array.size();
+			return _end;
 		}
 
 		constexpr bool empty() const
@@ -71,38 +189,63 @@ namespace havana::utl
 
 		[[nodiscard]] constexpr T& operator[](u32 id)
 		{
-			assert(id < _array.size() && !already_removed(id));
-			return _array[id];
+			assert(is_alive(id));
+			return item(id);
 		}
-		
+
 		[[nodiscard]] constexpr const T& operator[](u32 id) const
 		{
-			assert(id < _array.size() && !already_removed(id));
-			return _array[id];
+			assert(is_alive(id));
+			return item(id);
+		}
+
+		// Iterators over the live items in the order of their ids. Use iterator::id() to get the id of an item.
+		// Items can be removed while iterating, but only the one the iterator points to, after it was advanced.
+		[[nodiscard]] iterator begin() { return iterator{ this, 0 }; }
+		[[nodiscard]] const_iterator begin() const { return const_iterator{ this, 0 }; }
+		[[nodiscard]] iterator end() { return iterator{ this, (u32)_occupied.size() }; }
+		[[nodiscard]] const_iterator end() const { return const_iterator{ this, (u32)_occupied.size() }; }
+
+		void swap(free_list& o)
+		{
+			_chunks.swap(o._chunks);
+			_occupied.swap(o._occupied);
+			std::swap(_end, o._end);
+			std::swap(_next_free_index, o._next_free_index);
+			std::swap(_size, o._size);
 		}
 
 	private:
-		constexpr bool already_removed(u32 id) const
+		[[nodiscard]] constexpr static u64 bit(u32 id) { return u64{ 1 } << (id & (chunk_size - 1)); }
+
+		[[nodiscard]] constexpr void* slot(u32 id) const
 		{
-			// When sizeof(T) == sizeof(u32) we can't test if the item was already removed
-			if constexpr (sizeof(T) > sizeof(u32))
-			{
-				u32 i{ sizeof(u32) }; // Skip the first 4 bytes
-				const u8* const p{ (const u8* const)std::addressof(_array[id]) };
-				while ((p[i] == 0xcc) && (i < sizeof(T))) ++i;
-				return i == sizeof(T);
-			}
-			else
-			{
-				return true;
-			}
+			assert(id < _end);
+			return std::addressof(_chunks[id >> chunk_shift][id & (chunk_size - 1)]);
 		}
-#if USE_STL_VECTOR
-		utl::vector<T>				_array;
-#else
-		utl::vector<T, false>		_array;
-#endif
+
+		[[nodiscard]] constexpr T& item(u32 id) const
+		{
+			return *(T*)slot(id);
+		}
+
+		void add_chunk()
+		{
+			T* const chunk{ (T*)::operator new(sizeof(T) * chunk_size, std::align_val_t{ alignof(T) }) };
+			assert(chunk);
+			_chunks.emplace_back(chunk);
+			_occupied.emplace_back(0);
+		}
+
+		static void free_chunk(T* const chunk)
+		{
+			::operator delete(chunk, std::align_val_t{ alignof(T) });
+		}
+
+		utl::vector<T*>				_chunks;
+		utl::vector<u64>			_occupied;
+		u32							_end{ 0 };
 		u32							_next_free_index{ u32_invalid_id };
 		u32							_size{ 0 };
 	};
-}
\ No newline at end of file
+}
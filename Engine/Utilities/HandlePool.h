@@ -0,0 +1,159 @@
+#pragma once
+
+#include "CommonHeaders.h"
+
+namespace havana::utl
+{
+	// A pool of items addressed by generational ids (see Common/Id.h). Removed slots are kept in a
+	// FIFO free list that is threaded through the slots themselves, and a slot is only reused once
+	// more than 'recycle_delay' slots are waiting. This keeps generations from wrapping around too
+	// quickly and gives stale ids some time to be noticed. New slots are always appended, so their
+	// indices grow in the same order as the pool does, which other arrays can rely on.
+	template<typename T, u32 recycle_delay = id::min_deleted_elements>
+	class handle_pool
+	{
+		// NOTE: 'id' is the id of the item when it's alive. When the item is removed, we
+		//		 bump the generation right away, so any old id fails the is_alive() check.
+		//		 'next_free' links removed slots together and is 'used_slot' for live ones.
+		struct slot
+		{
+			id::id_type			id;
+			u32					next_free;
+			alignas(T) u8		storage[sizeof(T)];
+		};
+
+		constexpr static u32 used_slot{ u32_invalid_id - 1 };
+
+	public:
+		handle_pool() = default;
+		explicit handle_pool(u32 count) { _slots.reserve(count); }
+		DISABLE_COPY_AND_MOVE(handle_pool);
+		~handle_pool()
+		{
+			for (u32 i{ 0 }; i < _slots.size(); ++i)
+			{
+				if (_slots[i].next_free == used_slot) item(i).~T();
+			}
+		}
+
+		template<class... params>
+		[[nodiscard]] id::id_type add(params&&... p)
+		{
+			u32 index{ u32_invalid_id };
+			if (_free_count > recycle_delay)
+			{
+				index = _first_free;
+				_first_free = _slots[index].next_free;
+				if (_first_free == u32_invalid_id) _last_free = u32_invalid_id;
+				--_free_count;
+			}
+			else
+			{
+				index = (u32)_slots.size();
+				_slots.emplace_back(slot{ index, u32_invalid_id });
+			}
+
+			slot& s{ _slots[index] };
+			s.next_free = used_slot;
+			new (s.storage) T(std::forward<params>(p)...);
+			++_size;
+			return s.id;
+		}
+
+		void remove(id::id_type id)
+		{
+			assert(is_alive(id));
+			const u32 index{ id::index(id) };
+			item(index).~T();
+			DEBUG_OP(memset(_slots[index].storage, 0xcc, sizeof(T)));
+			--_size;
+
+			slot& s{ _slots[index] };
+			s.next_free = u32_invalid_id;
+			if (id::generation(id) + 1 >= id::detail::generation_mask)
+			{
+				// This slot has run out of generations, so we retire it for good.
+				s.id = id::invalid_id;
+				return;
+			}
+
+			s.id = id::new_generation(id);
+			if (_last_free == u32_invalid_id) _first_free = index;
+			else _slots[_last_free].next_free = index;
+			_last_free = index;
+			++_free_count;
+		}
+
+		// Makes sure that the next 'count' calls to add() won't reallocate.
+		void reserve(u32 count)
+		{
+			const u32 recyclable{ _free_count > recycle_delay ? _free_count - recycle_delay : 0 };
+			if (count > recyclable) _slots.reserve(_slots.size() + count - recyclable);
+		}
+
+		[[nodiscard]] bool is_alive(id::id_type id) const
+		{
+			assert(id::is_valid(id));
+			const u32 index{ id::index(id) };
+			assert(index < _slots.size());
+			return _slots[index].id == id;
+		}
+
+		[[nodiscard]] T& operator[](id::id_type id)
+		{
+			assert(is_alive(id));
+			return item(id::index(id));
+		}
+
+		[[nodiscard]] const T& operator[](id::id_type id) const
+		{
+			assert(is_alive(id));
+			return item(id::index(id));
+		}
+
+		// Number of items that are alive.
+		[[nodiscard]] u32 size() const { return _size; }
+		// Number of slots, including removed ones. Every index handed out by the pool is smaller than this.
+		[[nodiscard]] u32 capacity() const { return (u32)_slots.size(); }
+		[[nodiscard]] bool empty() const { return _size == 0; }
+
+		// Copies the pool as it is, including removed slots and generations, so ids stay valid after restore().
+		// NOTE: the slots are copied byte for byte, which only works for trivially copyable items.
+		[[nodiscard]] u64 snapshot_size() const
+		{
+			return sizeof(u64) + _slots.size() * sizeof(slot) + 4 * sizeof(u32);
+		}
+
+		template<typename W>
+		void save(W& writer) const
+		{
+			static_assert(std::is_trivially_copyable_v<T>);
+			writer.write_items(_slots);
+			writer.write(_first_free);
+			writer.write(_last_free);
+			writer.write(_free_count);
+			writer.write(_size);
+		}
+
+		template<typename R>
+		void restore(R& reader)
+		{
+			static_assert(std::is_trivially_copyable_v<T>);
+			reader.read_items(_slots);
+			_first_free = reader.template read<u32>();
+			_last_free = reader.template read<u32>();
+			_free_count = reader.template read<u32>();
+			_size = reader.template read<u32>();
+		}
+
+	private:
+		T& item(u32 index) { return *(T*)_slots[index].storage; }
+		const T& item(u32 index) const { return *(const T*)_slots[index].storage; }
+
+		utl::vector<slot, false>	_slots;
+		u32							_first_free{ u32_invalid_id };
+		u32							_last_free{ u32_invalid_id };
+		u32							_free_count{ 0 };
+		u32							_size{ 0 };
+	};
+}
\ No newline at end of file
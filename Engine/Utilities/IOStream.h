@@ -32,6 +32,17 @@ namespace havana::utl
 			_position += length;
 		}
 
+		// Reads items that were written by blob_stream_writer::write_items() into 'items', which is resized to fit.
+		template<typename V>
+		void read_items(V& items)
+		{
+			using T = std::remove_reference_t<decltype(items[0])>;
+			static_assert(std::is_trivially_copyable_v<T>, "Items must be trivially copyable.");
+			const u64 count{ read<u64>() };
+			items.resize(count);
+			if (count) read((u8*)items.data(), count * sizeof(T));
+		}
+
 		void skip(size_t offset)
 		{
 			_position += offset;
@@ -83,6 +94,23 @@ namespace havana::utl
 			_position += length;
 		}
 
+		// Writes the number of items in 'items' (e.g. a utl::vector) followed by the items themselves.
+		template<typename V>
+		void write_items(const V& items)
+		{
+			using T = std::remove_const_t<std::remove_reference_t<decltype(items[0])>>;
+			static_assert(std::is_trivially_copyable_v<T>, "Items must be trivially copyable.");
+			write((u64)items.size());
+			if (items.size()) write((const u8*)items.data(), items.size() * sizeof(T));
+		}
+
+		// Number of bytes that write_items() writes for 'items'.
+		template<typename V>
+		[[nodiscard]] static constexpr u64 items_size(const V& items)
+		{
+			return sizeof(u64) + items.size() * sizeof(items[0]);
+		}
+
 		void skip(size_t offset)
 		{
 			assert(&_position[offset] <= &_buffer[_buffer_size]);
@@ -20,6 +20,7 @@ namespace havana::math
 	using s32v3 = DirectX::XMINT3;
 	using s32v4 = DirectX::XMINT4;
 	using m3x3 = DirectX::XMFLOAT3X3;
+	using m3x4 = DirectX::XMFLOAT3X4;
 	using m4x4 = DirectX::XMFLOAT4X4;
 	using m4x4a = DirectX::XMFLOAT4X4A;
 }
\ No newline at end of file
@@ -0,0 +1,400 @@
+#pragma once
+#include "CommonHeaders.h"
+#include "Allocators.h"
+
+namespace havana::utl
+{
+	// A vector that keeps up to N items inside the object itself and only allocates memory when
+	// it grows beyond that. It has the same interface as utl::vector, which makes it a drop-in
+	// replacement for the many small arrays that usually hold only a few items.
+	// NOTE: like utl::vector, items are moved around with memcpy. The inline items don't point
+	//		 to the vector, so a small_vector can itself be stored in a utl::vector.
+	template<typename T, u32 N, bool destruct = true, typename allocator = heap_allocator>
+	class small_vector : private detail::allocator_ref<allocator>
+	{
+		static_assert(N > 0, "Use utl::vector if there's no inline storage.");
+		using allocator_base = detail::allocator_ref<allocator>;
+
+	public:
+		// Default constructor, doesn't allocate memory.
+		small_vector() = default;
+
+		// Constructor resizes the vector and initializes 'count' items.
+		constexpr explicit small_vector(u64 count) { resize(count); }
+
+		// Constructor resizes the vector and initializes 'count' items using 'value'.
+		constexpr explicit small_vector(u64 count, const T& value) { resize(count, value); }
+
+		// Constructors that take memory from 'a' when the vector grows beyond N items. It must outlive the vector.
+		constexpr explicit small_vector(allocator& a) : allocator_base{ a } {}
+		constexpr explicit small_vector(u64 count, allocator& a) : allocator_base{ a } { resize(count); }
+		constexpr explicit small_vector(u64 count, const T& value, allocator& a) : allocator_base{ a } { resize(count, value); }
+
+		// Destructs the vector and its items as specified in the template argument
+		~small_vector() { destroy(); }
+
+		// Copy-constructor. Constructs by copying another vector. The items
+		// in the copied vector must be copyable. Uses the same allocator.
+		constexpr small_vector(const small_vector& o) : allocator_base{ o } { *this = o; }
+
+		// Move-constructor. Constructs by moving another vector.
+		// The original vector will be empty after move.
+		constexpr small_vector(small_vector&& o) : allocator_base{ o } { move(o); }
+
+		// Copy-assignment operator. Clears this vector and copies items
+		// from another vector. The items must be copyable. Keeps its own
+		// allocator, or uses the one of the other vector if it has none.
+		constexpr small_vector& operator=(const small_vector& o)
+		{
+			assert(this != std::addressof(o));
+			if (this != std::addressof(o))
+			{
+				if (!allocator_base::has_allocator()) allocator_base::operator=(o);
+				clear();
+				reserve(o._size);
+				for (auto& item : o)
+				{
+					emplace_back(item);
+				}
+				assert(_size == o._size);
+			}
+
+			return *this;
+		}
+
+		// Move-assignment operator. Frees all resources in this vector and
+		// moves the other vector into this one.
+		constexpr small_vector& operator=(small_vector&& o)
+		{
+			assert(this != std::addressof(o));
+			if (this != std::addressof(o))
+			{
+				destroy();
+				move(o);
+			}
+
+			return *this;
+		}
+
+		// Inserts an item at the end of the vector by copying 'value'
+		constexpr void push_back(const T& value)
+		{
+			emplace_back(value);
+		}
+
+		// Inserts an item at the end of the vector by moving 'value'
+		constexpr void push_back(const T&& value)
+		{
+			emplace_back(std::move(value));
+		}
+
+		// Copy-constructs or move-constructs an item at the end of the vector
+		template<typename... params>
+		constexpr decltype(auto) emplace_back(params&&... p)
+		{
+			if (_size == _capacity)
+			{
+				reserve(((_capacity + 1) * 3) >> 1); // reserves 50% more space
+			}
+			assert(_size < _capacity);
+
+			T* const item{ new (std::addressof(data()[_size])) T(std::forward<params>(p)...) };
+			++_size;
+
+			return *item;
+		}
+
+		// Resizes the vector and initializes new items with their default value.
+		constexpr void resize(u64 new_size)
+		{
+			static_assert(std::is_default_constructible<T>::value, "Type must be default-constructable.");
+
+			if (new_size > _size)
+			{
+				reserve(new_size);
+				while (_size < new_size)
+				{
+					emplace_back();
+				}
+			}
+			else if (new_size < _size)
+			{
+				if constexpr (destruct)
+				{
+					destruct_range(new_size, _size);
+				}
+
+				_size = new_size;
+			}
+
+			// Do nothing if new_size == _size
+			assert(new_size == _size);
+		}
+
+		// Resizes the vector and initializes new items by copying 'value'.
+		constexpr void resize(u64 new_size, const T& value)
+		{
+			static_assert(std::is_copy_constructible<T>::value, "Type must be copy-constructable.");
+			if (new_size > _size)
+			{
+				reserve(new_size);
+				while (_size < new_size)
+				{
+					emplace_back(value);
+				}
+			}
+			else if (new_size < _size)
+			{
+				if constexpr (destruct)
+				{
+					destruct_range(new_size, _size);
+				}
+
+				_size = new_size;
+			}
+
+			// Do nothing if new_size == _size
+			assert(new_size == _size);
+		}
+
+		// Allocates memory to contain the specified number of items. Does nothing
+		// while the items fit into the inline storage.
+		constexpr void reserve(u64 new_capacity)
+		{
+			if (new_capacity > _capacity)
+			{
+				const bool is_inline{ !is_allocated() };
+				// NOTE: like realloc(), the allocator copies the data in the buffer if a new region of memory is allocated
+				void* new_buffer{ allocator_base::get_allocator().reallocate(is_inline ? nullptr : _storage.heap,
+																			 is_inline ? 0 : _capacity * sizeof(T),
+																			 new_capacity * sizeof(T), alignof(T)) };
+				assert(new_buffer);
+				if (new_buffer)
+				{
+					if (is_inline) memcpy(new_buffer, _storage.items, _size * sizeof(T));
+					_storage.heap = static_cast<T*>(new_buffer);
+					_capacity = new_capacity;
+				}
+			}
+		}
+
+		// Removes the item at specified index
+		constexpr T* const erase(u64 index)
+		{
+			assert(index < _size);
+			return erase(std::addressof(data()[index]));
+		}
+
+		// Removes the item at specifies location
+		constexpr T* const erase(T* const item)
+		{
+			T* const items{ data() };
+			assert(item >= std::addressof(items[0]) && item < std::addressof(items[_size]));
+			if constexpr (destruct) item->~T();
+			--_size;
+			if (item < std::addressof(items[_size]))
+			{
+				memmove(item, item + 1, (std::addressof(items[_size]) - item) * sizeof(T));
+			}
+
+			return item;
+		}
+
+		// Same as erase() but faster because it just copies the last item
+		constexpr T* const erase_unordered(u64 index)
+		{
+			assert(index < _size);
+			return erase_unordered(std::addressof(data()[index]));
+		}
+
+		// Same as erase() but faster because it just copies the last item
+		constexpr T* const erase_unordered(T* const item)
+		{
+			T* const items{ data() };
+			assert(item >= std::addressof(items[0]) && item < std::addressof(items[_size]));
+			if constexpr (destruct) item->~T();
+			--_size;
+			if (item < std::addressof(items[_size]))
+			{
+				memcpy(item, std::addressof(items[_size]), sizeof(T));
+			}
+
+			return item;
+		}
+
+		// Clears vector and destructs items as specified in the template argument
+		constexpr void clear()
+		{
+			if constexpr (destruct)
+			{
+				destruct_range(0, _size);
+			}
+
+			_size = 0;
+		}
+
+		// Sets the allocator of a vector that hasn't allocated any memory yet.
+		constexpr void set_allocator(allocator& a)
+		{
+			assert(!is_allocated());
+			allocator_base::set_allocator(a);
+		}
+
+		// Swaps two vectors, including their allocators
+		constexpr void swap(small_vector& o)
+		{
+			if (this != std::addressof(o))
+			{
+				auto temp(std::move(o));
+				o.move(*this);
+				move(temp);
+			}
+		}
+
+		// Pointer to the start of data, never null
+		[[nodiscard]] constexpr T* data()
+		{
+			return is_allocated() ? _storage.heap : reinterpret_cast<T*>(_storage.items);
+		}
+
+		// Pointer to the start of data, never null
+		[[nodiscard]] constexpr const T* data() const
+		{
+			return is_allocated() ? _storage.heap : reinterpret_cast<const T*>(_storage.items);
+		}
+
+		// Returns true if empty
+		[[nodiscard]] constexpr bool empty() const
+		{
+			return _size == 0;
+		}
+
+		// Returns number of items in the vector
+		[[nodiscard]] constexpr u64 size() const
+		{
+			return _size;
+		}
+
+		// Returns the capacity of the vector, which is at least N
+		[[nodiscard]] constexpr u64 capacity() const
+		{
+			return _capacity;
+		}
+
+		// Returns true if the items don't fit into the inline storage anymore.
+		[[nodiscard]] constexpr bool is_allocated() const
+		{
+			return _capacity > N;
+		}
+
+		// Indexing operator - returns a reference to the item at the specified index.
+		[[nodiscard]] constexpr T& operator[](u64 index)
+		{
+			assert(index < _size);
+			return data()[index];
+		}
+
+		// Indexing operator - returns a constant reference to the item at the specified index.
+		[[nodiscard]] constexpr const T& operator[](u64 index) const
+		{
+			assert(index < _size);
+			return data()[index];
+		}
+
+		// Returns a reference to the first element of the array
+		[[nodiscard]] constexpr T& front()
+		{
+			assert(_size);
+			return data()[0];
+		}
+
+		// Returns a constant reference to the first element of the array
+		[[nodiscard]] constexpr const T& front() const
+		{
+			assert(_size);
+			return data()[0];
+		}
+
+		// Returns a reference to the last element of the array
+		[[nodiscard]] constexpr T& back()
+		{
+			assert(_size);
+			return data()[_size - 1];
+		}
+
+		// Returns a constant reference to the last element of the array
+		[[nodiscard]] constexpr const T& back() const
+		{
+			assert(_size);
+			return data()[_size - 1];
+		}
+
+		// Returns a pointer to the first element of the array
+		[[nodiscard]] constexpr T* begin()
+		{
+			return data();
+		}
+
+		// Returns a constant pointer to the first element of the array
+		[[nodiscard]] constexpr const T* begin() const
+		{
+			return data();
+		}
+
+		// Returns a pointer past the last element of the array
+		[[nodiscard]] constexpr T* end()
+		{
+			return data() + _size;
+		}
+
+		// Returns a constant pointer past the last element of the array
+		[[nodiscard]] constexpr const T* end() const
+		{
+			return data() + _size;
+		}
+
+	private:
+		// Takes the items of 'o', which must be empty or destroyed. Inline items are copied, allocated ones change owner.
+		constexpr void move(small_vector& o)
+		{
+			allocator_base::operator=(o);
+			_capacity = o._capacity;
+			_size = o._size;
+			if (o.is_allocated()) _storage.heap = o._storage.heap;
+			else memcpy(_storage.items, o._storage.items, o._size * sizeof(T));
+			o.reset();
+		}
+
+		constexpr void reset()
+		{
+			_capacity = N;
+			_size = 0;
+		}
+
+		constexpr void destruct_range(u64 first, u64 last)
+		{
+			assert(destruct);
+			assert(first <= _size && last <= _size && first <= last);
+			T* const items{ data() };
+			for (; first != last; ++first)
+			{
+				items[first].~T();
+			}
+		}
+
+		constexpr void destroy()
+		{
+			clear();
+			if (is_allocated()) allocator_base::get_allocator().deallocate(_storage.heap, _capacity * sizeof(T));
+			reset();
+		}
+
+		u64 _capacity{ N };
+		u64 _size{ 0 };
+		union storage
+		{
+			T*						heap;
+			alignas(T) u8			items[N * sizeof(T)];
+		} _storage;
+	};
+}
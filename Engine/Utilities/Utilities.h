@@ -3,7 +3,7 @@
 // Set these flags to 1 to use STL vector and deque
 // Set these flags to 0 to use custom implementeation of those containers
 #define USE_STL_VECTOR 0
-#define USE_STL_DEQUE 1
+#define USE_STL_DEQUE 0
 
 #if USE_STL_VECTOR
 	#include <vector>
@@ -45,13 +45,11 @@
 		template<typename T>
 		using deque = std::deque<T>;
 	}
+#else
+	#include "Deque.h"
 #endif
 
-namespace havana::utl
-{
-	// TODO: implement our own containers
-}
-
+#include "SmallVector.h"
 #include "FreeList.h"
 #ifndef _WIN64
 template < typename T, size_t N >
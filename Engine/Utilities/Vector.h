@@ -1,5 +1,6 @@
 #pragma once
 #include "CommonHeaders.h"
+#include "Allocators.h"
 
 namespace havana::utl
 {
@@ -25,10 +26,13 @@ namespace havana::utl
 	// A vector class similar to std::vector with basic functionality.
 	// The user can specify in the template argument whether they want
 	// the element's desctructor to be called when being removed or while
-	// clearing/destructing the vector.
-	template<typename T, bool destruct = true>
-	class vector
+	// clearing/destructing the vector. Memory comes from the heap, unless
+	// another allocator is specified (see Allocators.h).
+	template<typename T, bool destruct = true, typename allocator = heap_allocator>
+	class vector : private detail::allocator_ref<allocator>
 	{
+		using allocator_base = detail::allocator_ref<allocator>;
+
 	public:
 		// Default constructor, doesn't allocate memory.
 		vector() = default;
@@ -38,6 +42,11 @@ namespace havana::utl
 		
 		// Constructor resizes the vector and initializes 'count' items using 'value'.
 		constexpr explicit vector(u64 count, const T& value) { resize(count, value); }
+
+		// Constructors that take memory from 'a'. It must outlive the vector.
+		constexpr explicit vector(allocator& a) : allocator_base{ a } {}
+		constexpr explicit vector(u64 count, allocator& a) : allocator_base{ a } { resize(count); }
+		constexpr explicit vector(u64 count, const T& value, allocator& a) : allocator_base{ a } { resize(count, value); }
 	
 	//#ifdef _WIN64
 	//	template<typename it, typename = std::enable_if_t<std::_Is_iterator_v<it>>>
@@ -56,20 +65,22 @@ namespace havana::utl
 		~vector() { destroy(); }
 
 		// Copy-constructor. Constructs by copying another vector. The items
-		// in the copied vector must be copyable.
-		constexpr vector(const vector& o) { *this = o; }
+		// in the copied vector must be copyable. Uses the same allocator.
+		constexpr vector(const vector& o) : allocator_base{ o } { *this = o; }
 		
 		// Move-constructor. Constructs by moving another vector.
 		// The original vector will be empty after move.
-		constexpr vector(vector&& o) : _capacity{ o._capacity }, _size{ o._size }, _data{ o._data } {o.reset(); }
+		constexpr vector(vector&& o) : allocator_base{ o }, _capacity{ o._capacity }, _size{ o._size }, _data{ o._data } {o.reset(); }
 
 		// Copy-assignment operator. Clears this vector and copies items
-		// from another vector. The items must be copyable.
+		// from another vector. The items must be copyable. Keeps its own
+		// allocator, or uses the one of the other vector if it has none.
 		constexpr vector& operator=(const vector& o)
 		{
 			assert(this != std::addressof(o));
 			if (this != std::addressof(o))
 			{
+				if (!allocator_base::has_allocator()) allocator_base::operator=(o);
 				clear();
 				reserve(o._size);
 				for (auto& item : o)
@@ -182,8 +193,8 @@ namespace havana::utl
 		{
 			if (new_capacity > _capacity)
 			{
-				// NOTE: realoc() will automatically copy the data in the buffer if a new region of memory is allocated
-				void* new_buffer{ realloc(_data, new_capacity * sizeof(T)) };
+				// NOTE: like realloc(), the allocator copies the data in the buffer if a new region of memory is allocated
+				void* new_buffer{ allocator_base::get_allocator().reallocate(_data, _capacity * sizeof(T), new_capacity * sizeof(T), alignof(T)) };
 				assert(new_buffer);
 				if (new_buffer)
 				{
@@ -246,7 +257,14 @@ namespace havana::utl
 			_size = 0;
 		}
 
-		// Swaps two vectors
+		// Sets the allocator of a vector that hasn't allocated any memory yet.
+		constexpr void set_allocator(allocator& a)
+		{
+			assert(!_data);
+			allocator_base::set_allocator(a);
+		}
+
+		// Swaps two vectors, including their allocators
 		constexpr void swap(vector& o)
 		{
 			if (this != std::addressof(o))
@@ -358,6 +376,7 @@ namespace havana::utl
 	private:
 		constexpr void move(vector& o)
 		{
+			allocator_base::operator=(o);
 			_capacity = o._capacity;
 			_size = o._size;
 			_data = o._data;
@@ -388,8 +407,8 @@ namespace havana::utl
 		{
 			assert([&] { return _capacity ? _data != nullptr : _data == nullptr; }());
 			clear();
+			if (_data) allocator_base::get_allocator().deallocate(_data, _capacity * sizeof(T));
 			_capacity = 0;
-			if (_data) free(_data);
 			_data = nullptr;
 		}
 
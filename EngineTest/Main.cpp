@@ -10,6 +10,8 @@
 //#include "TestRenderer.h"
 #include "TestRendererWin32.h"
 #include "TestRendererLinux.h"
+#elif TEST_DEQUE
+#include "TestDeque.h"
 #else
 #error One of the tests must be enabled
 #endif
@@ -7,6 +7,7 @@
 #include "Graphics/Renderer.h"
 #include "ShaderCompilation.h"
 #include "Components/Entity.h"
+#include "Components/Animation.h"
 #include "../ContentTools/Geometry.h"
 
 using namespace havana;
@@ -26,6 +27,7 @@ namespace
 	id::id_type lab_item_id{ id::invalid_id };
 	
 	game_entity::entity_id fan_entity_id{ id::invalid_id };
+	animation::clip_id fan_clip_id{ id::invalid_id };
 	game_entity::entity_id int_entity_id{ id::invalid_id };
 	game_entity::entity_id lab_entity_id{ id::invalid_id };
 	
@@ -101,6 +103,27 @@ namespace
 		mtl_id = content::create_resource(&info, content::asset_type::material);
 	}
 
+	// The fan spins once per second around its x-axis. Rotation keys are interpolated linearly,
+	// so we put one every 45 degrees.
+	void
+	create_fan_clip()
+	{
+		constexpr u32 key_count{ 9 };
+		f32 times[key_count];
+		math::v4 rotations[key_count];
+		for (u32 i{ 0 }; i < key_count; ++i)
+		{
+			times[i] = (f32)i / (key_count - 1);
+			const math::v3a rot{ -times[i] * math::two_pi, 0.f, 0.f };
+			DirectX::XMStoreFloat4(&rotations[i], DirectX::XMQuaternionRotationRollPitchYawFromVector(DirectX::XMLoadFloat3A(&rot)));
+		}
+
+		animation::clip_info info{};
+		info.tracks[animation::track_type::rotation] = { &times[0], &rotations[0], key_count };
+		info.duration = 1.f;
+		fan_clip_id = animation::create_clip(info);
+	}
+
 	void
 	remove_item(game_entity::entity_id entity_id, id::id_type item_id, id::id_type model_id)
 	{
@@ -131,7 +154,9 @@ create_render_item()
 	auto _4 = std::thread{ [] { load_shaders(); } };
 
 	lab_entity_id = create_one_game_entity({}, {}, nullptr).get_id();
-	fan_entity_id = create_one_game_entity({ -10.47f, 5.93f, -6.7f }, {}, "fan_script").get_id();
+	fan_entity_id = create_one_game_entity({ -10.47f, 5.93f, -6.7f }, {}, nullptr).get_id();
+	create_fan_clip();
+	animation::play(fan_entity_id, { fan_clip_id });
 	int_entity_id = create_one_game_entity({ 0.f, 1.3f, -6.6f }, {}, "wibbly_wobbly_script").get_id();
 
 	_1.join();
@@ -158,6 +183,11 @@ destroy_render_item()
 	remove_item(lab_entity_id, lab_item_id, lab_model_id);
 	remove_item(fan_entity_id, fan_item_id, fan_model_id);
 	remove_item(int_entity_id, int_item_id, int_model_id);
+	if (id::is_valid(fan_clip_id))
+	{
+		animation::stop(fan_entity_id);
+		animation::remove_clip(fan_clip_id);
+	}
 
 	// remove material
 	if (id::is_valid(mtl_id))
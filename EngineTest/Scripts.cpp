@@ -132,6 +132,12 @@ public:
 		{
 			camera_seek(dt);
 		}
+
+		// Nothing to do until the input handlers wake us up again.
+		if (_move_magnitude <= math::epsilon && !_move_position && !_move_rotation)
+		{
+			sleep();
+		}
 	}
 
 private:
@@ -141,6 +147,7 @@ private:
 
 		_move = XMLoadFloat3(&value.current);
 		_move_magnitude = XMVectorGetX(XMVector3LengthSq(_move));
+		script::wake(script());
 	}
 
 	void mouse_move(input::input_source::type type, input::input_code::code code, const input::input_value& mouse_pos)
@@ -163,6 +170,7 @@ private:
 
 			_desired_spherical = DirectX::XMLoadFloat3(&spherical);
 			_move_rotation = true;
+			script::wake(script());
 			
 		}
 	}
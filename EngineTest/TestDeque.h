@@ -0,0 +1,138 @@
+#pragma once
+
+#include <iostream>
+#include <deque>
+#include "Test.h"
+#include "Utilities/Deque.h"
+
+using namespace havana;
+
+// Compares utl::deque with std::deque on the churn of a free-id queue: every round some
+// entities are created, reusing the oldest free id once more than id::min_deleted_elements
+// ids are waiting, and some are removed, which queues their ids. The number of removes
+// per round goes up and down, so the queue grows while its items wrap around the end of
+// the ring buffer. A share of the removed ids is pushed to the front of the queue.
+class engine_test : public test
+{
+public:
+	virtual bool initialize() override
+	{
+		check_wrap_around_growth();
+		return true;
+	}
+
+	virtual void run() override
+	{
+		do
+		{
+			std::deque<u32> std_queue;
+			utl::deque<u32> utl_queue;
+			u64 std_checksum{ 0 };
+			u64 utl_checksum{ 0 };
+			const f32 std_ms{ churn(std_queue, std_checksum) };
+			const f32 utl_ms{ churn(utl_queue, utl_checksum) };
+			assert(std_checksum == utl_checksum);
+			assert(std_queue.size() == utl_queue.size());
+
+			std::cout << "Entity churn, " << rounds << " rounds" << std::endl;
+			std::cout << "  std::deque: " << std_ms << " ms" << std::endl;
+			std::cout << "  utl::deque: " << utl_ms << " ms" << std::endl;
+			std::cout << "  ids match: " << (std_checksum == utl_checksum ? "yes" : "no") << std::endl;
+		} while (getchar() != 'q');
+	}
+
+	virtual void shutdown() override
+	{
+	}
+
+private:
+	constexpr static u32 rounds{ 200000 };
+	constexpr static u32 creates_per_round{ 64 };
+
+	// Replays the same pseudo-random churn on 'free_ids' and returns the time it took in milliseconds.
+	// 'checksum' accumulates the ids in the order they were handed out.
+	template<typename Q>
+	static f32 churn(Q& free_ids, u64& checksum)
+	{
+		utl::vector<u32> live;
+		u32 next_id{ 0 };
+		u32 seed{ 12345 };
+
+		const auto start{ time_it::clock::now() };
+		for (u32 round{ 0 }; round < rounds; ++round)
+		{
+			for (u32 i{ 0 }; i < creates_per_round; ++i)
+			{
+				u32 id{ next_id };
+				if (free_ids.size() > id::min_deleted_elements)
+				{
+					id = free_ids.front();
+					free_ids.pop_front();
+				}
+				else
+				{
+					++next_id;
+				}
+
+				live.emplace_back(id);
+				checksum = checksum * 31 + id;
+			}
+
+			// Remove between 0 and 2x as many entities as were created in this round.
+			const u32 removes{ std::min((u32)live.size(), random(seed) % (2 * creates_per_round + 1)) };
+			for (u32 i{ 0 }; i < removes; ++i)
+			{
+				const u32 index{ random(seed) % (u32)live.size() };
+				const u32 id{ live[index] };
+				utl::erase_unordered(live, index);
+				if (id & 7) free_ids.push_back(id);
+				else free_ids.push_front(id);
+			}
+		}
+
+		return std::chrono::duration<f32, std::milli>(time_it::clock::now() - start).count();
+	}
+
+	// Grows the deque while its items wrap around the end of the buffer and checks
+	// that front-to-back order is kept, using push_front and push_back alike.
+	static void check_wrap_around_growth()
+	{
+		std::deque<u32> expected;
+		utl::deque<u32> queue;
+		u32 value{ 0 };
+		for (u32 step{ 0 }; step < 16; ++step)
+		{
+			for (u32 i{ 0 }; i < 5 && !expected.empty(); ++i)
+			{
+				expected.pop_front();
+				queue.pop_front();
+			}
+
+			for (u32 i{ 0 }; i < 7 + step; ++i, ++value)
+			{
+				if (value % 3)
+				{
+					expected.push_back(value);
+					queue.push_back(value);
+				}
+				else
+				{
+					expected.push_front(value);
+					queue.push_front(value);
+				}
+			}
+
+			assert(queue.size() == expected.size());
+			for (u32 i{ 0 }; i < (u32)expected.size(); ++i)
+			{
+				assert(queue[i] == expected[i]);
+			}
+		}
+	}
+
+	static u32 random(u32& seed)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		return seed >> 8;
+	}
+};
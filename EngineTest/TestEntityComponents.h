@@ -61,17 +61,21 @@ private:
 	{
 		u32 count = rand() % 20;
 		if (_entities.empty()) count = 1000;
+		if (!count) return;
+
 		transform::init_info transform_info{};
-		game_entity::entity_info entity_info { &transform_info };
+		utl::vector<game_entity::entity_info> infos(count, game_entity::entity_info{ &transform_info });
 
-		while (count > 0)
+		const u32 first{ (u32)_entities.size() };
+		_entities.resize(first + count);
+		game_entity::create_batch(infos.data(), count, &_entities[first]);
+		_added += count;
+
+		for (u32 i{ first }; i < first + count; ++i)
 		{
-			++_added;
-			game_entity::entity entity{ game_entity::create(entity_info) };
+			const game_entity::entity entity{ _entities[i] };
 			assert(entity.is_valid() && id::is_valid(entity.get_id()));
-			_entities.push_back(entity);
 			assert(game_entity::is_alive(entity.get_id()));
-			--count;
 		}
 	}
 
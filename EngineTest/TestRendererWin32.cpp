@@ -10,7 +10,10 @@
 #include "Components/Entity.h"
 #include "Components/Transform.h"
 #include "Components/Script.h"
+#include "Core/FrameMemory.h"
+#include "Components/World.h"
 #include "Input/Input.h"
+#include "Jobs/Jobs.h"
 #include "TestRendererWin32.h"
 #include "ShaderCompilation.h"
 
@@ -264,6 +267,7 @@ test_initialize()
 			return false;
 	}
 
+	if (!jobs::initialize()) return false;
 	if (!graphics::initialize(graphics::graphics_platform::direct3d12)) return false;
 
 	platform::window_init_info info[]{
@@ -341,6 +345,7 @@ test_shutdown()
 		destroy_camera_surface(_surfaces[i]);
 
 	graphics::shutdown();
+	jobs::shutdown();
 }
 
 bool
@@ -362,9 +367,10 @@ engine_test::run()
 	//if ((counter % 90) == 0) light_set_key = (light_set_key + 1) % 2;
 	
 	timer.begin();
+	memory::begin_frame();
 	//std::this_thread::sleep_for(std::chrono::milliseconds(10));
 	const f32 dt{ timer.dt_avg() };
-	script::update(dt);
+	world::update(world::current(), dt);
 	//test_lights(dt);
 
 	for (u32 i{ 0 }; i < _countof(_surfaces); ++i)
@@ -155,7 +155,7 @@ project "EngineTest"
         includedirs { "%{wks.location}/Engine", "%{wks.location}/Engine/Common" }
         buildoptions { "-Wno-switch -Wno-missing-field-initializers -Wno-unused-parameter -Wno-ignored-qualifiers -Wno-unknown-pragmas -Wno-class-memaccess -Wno-reorder" }
         libdirs (outputdir)
-        links { "X11", "Engine" }
+        links { "X11", "Engine", "pthread" }
     end
     targetdir (outputdir)
     objdir (intermediatesdir)